@@ -0,0 +1,241 @@
+#include "access-order.h"
+
+#include "memory.h"
+#include "params.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern ProfileParams *p;
+
+static LatMatrix *g_lat = NULL;
+
+// FNV-1a of the mapping functions, a new layout gets a new matrix
+static uint64_t layout_hash()
+{
+	uint8_t *b = (uint8_t *) get_dram_layout();
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < sizeof(DRAMLayout); i++) {
+		h ^= b[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ Median cycles of two back to back loads from a_v and b_v. Every rep
+ alternates between two rows of each side so that both loads open a new
+ row, whether the banks differ or not.
+ */
+static uint32_t time_pair(char *a_v[2], char *b_v[2])
+{
+	uint32_t t[LAT_REPS];
+
+	for (int i = 0; i < LAT_REPS; i++) {
+		char *a = a_v[i & 1], *b = b_v[i & 1];
+		clflushopt(a);
+		clflushopt(b);
+		mfence();
+		uint64_t t0 = rdtscp();
+		*(volatile char *)a;
+		*(volatile char *)b;
+		t[i] = rdtscp() - t0;
+	}
+	qsort(t, LAT_REPS, sizeof(uint32_t), cmp_u32);
+	return t[LAT_REPS / 2];
+}
+
+static void measure_lat_matrix(MemoryBuffer * mem, LatMatrix * m)
+{
+	DRAMAddr d_base = phys_2_dram(virt_2_phys(mem->buffer, mem));
+	char *v[LAT_BANKS][4];
+
+	// first full row of the buffer onwards, 4 rows per bank
+	for (uint64_t bk = 0; bk < m->banks; bk++) {
+		for (int r = 0; r < 4; r++) {
+			DRAMAddr d = {.bank = bk,.row = d_base.row + 1 + r,.col = 0 };
+			v[bk][r] = phys_2_virt(dram_2_phys(d), mem);
+		}
+	}
+	// loads overlap, the order within a pair barely matters: keep it symmetric
+	for (uint64_t a = 0; a < m->banks; a++) {
+		for (uint64_t b = a; b < m->banks; b++) {
+			char *a_v[2] = { v[a][0], v[a][1] };
+			char *b_v[2] = { v[b][2], v[b][3] };
+			m->lat[a][b] = m->lat[b][a] = time_pair(a_v, b_v);
+		}
+	}
+}
+
+LatMatrix *get_lat_matrix(MemoryBuffer * mem)
+{
+	uint64_t h = layout_hash();
+	char f_name[256];
+
+	if (g_lat != NULL && g_lat->layout == h)
+		return g_lat;
+	if (g_lat == NULL)
+		g_lat = (LatMatrix *) malloc(sizeof(LatMatrix));
+
+	create_dir(DATA_DIR);
+	sprintf(f_name, "%slat.%016lx.bin", DATA_DIR, h);
+	FILE *fp = fopen(f_name, "rb");
+	if (fp != NULL) {
+		size_t ok = fread(g_lat, sizeof(LatMatrix), 1, fp);
+		fclose(fp);
+		if (ok == 1 && g_lat->magic == LAT_MAGIC && g_lat->layout == h
+		    && g_lat->banks == get_banks_cnt())
+			return g_lat;
+		fprintf(stderr, "[WARN] - %s is stale, measuring again\n", f_name);
+	}
+
+	memset(g_lat, 0, sizeof(LatMatrix));
+	g_lat->magic = LAT_MAGIC;
+	g_lat->layout = h;
+	g_lat->banks = get_banks_cnt();
+	fprintf(stderr, "[LOG] - Measuring bank pair latencies (%ld banks)\n", g_lat->banks);
+	measure_lat_matrix(mem, g_lat);
+
+	fp = fopen(f_name, "wb");
+	if (fp == NULL || fwrite(g_lat, sizeof(LatMatrix), 1, fp) != 1)
+		perror("[WARN] - Unable to cache bank pair latencies");
+	if (fp != NULL)
+		fclose(fp);
+	return g_lat;
+}
+
+static uint64_t step_cost(LatMatrix * m, DRAMAddr * a, DRAMAddr * b)
+{
+	if (d_addr_eq_row(a, b))
+		return LAT_HIT;
+	return m->lat[a->bank][b->bank];
+}
+
+// cycles of one round accessed in order (array order if NULL), rounds wrap around
+uint64_t order_cost(LatMatrix * m, HammerPattern * h_patt, size_t * order)
+{
+	DRAMAddr *d = h_patt->d_lst;
+	uint64_t cost = 0;
+
+	for (size_t k = 0; k < h_patt->len; k++) {
+		size_t i = order ? order[k] : k;
+		size_t j = order ? order[(k + 1) % h_patt->len] : (k + 1) % h_patt->len;
+		cost += step_cost(m, &d[i], &d[j]);
+	}
+	return cost;
+}
+
+/*
+ Fills order with the access sequence of one round: nearest neighbour
+ from the first aggressor, then a few 2-opt passes. Ties keep the array
+ order, so a pattern with nothing to gain is left untouched. Returns the
+ cost of the new order.
+ */
+uint64_t order_accesses(LatMatrix * m, HammerPattern * h_patt, size_t * order)
+{
+	DRAMAddr *d = h_patt->d_lst;
+	size_t n = h_patt->len;
+	bool *used = (bool *) calloc(n, sizeof(bool));
+
+	if (n == 0) {
+		free(used);
+		return 0;
+	}
+	order[0] = 0;
+	used[0] = true;
+	for (size_t k = 1; k < n; k++) {
+		size_t best = 0;
+		uint64_t best_c = ~0ULL;
+		for (size_t j = 1; j < n; j++) {
+			if (used[j])
+				continue;
+			uint64_t c = step_cost(m, &d[order[k - 1]], &d[j]);
+			if (c < best_c) {
+				best = j;
+				best_c = c;
+			}
+		}
+		order[k] = best;
+		used[best] = true;
+	}
+	free(used);
+
+	for (int pass = 0; pass < ORDER_PASSES; pass++) {
+		bool improved = false;
+		for (size_t i = 0; i + 2 < n; i++) {
+			for (size_t j = i + 2; j < n; j++) {
+				if (i == 0 && j == n - 1)
+					continue;
+				DRAMAddr *a = &d[order[i]], *b = &d[order[i + 1]];
+				DRAMAddr *c = &d[order[j]], *e = &d[order[(j + 1) % n]];
+				int64_t delta = (int64_t) (step_cost(m, a, c) + step_cost(m, b, e))
+				    - (int64_t) (step_cost(m, a, b) + step_cost(m, c, e));
+				if (delta >= 0)
+					continue;
+				for (size_t lo = i + 1, hi = j; lo < hi; lo++, hi--) {
+					size_t tmp = order[lo];
+					order[lo] = order[hi];
+					order[hi] = tmp;
+				}
+				improved = true;
+			}
+		}
+		if (!improved)
+			break;
+	}
+	return order_cost(m, h_patt, order);
+}
+
+/*
+ Hammers BENCH_PATTS random patterns (aggressors on random banks) in array
+ order and in timing order and reports the activation rate of both.
+ */
+void order_bench(SessionConfig * cfg, MemoryBuffer * mem)
+{
+	LatMatrix *m = get_lat_matrix(mem);
+	DRAMAddr d_base = phys_2_dram(virt_2_phys(mem->buffer, mem));
+	HammerPattern h_patt;
+	size_t order[PATT_LEN];
+	double rate[2] = { 0, 0 };
+	int reorder = p->reorder;
+
+	d_base.row += cfg->base_off;
+	d_base.col = 0;
+	h_patt.d_lst = (DRAMAddr *) malloc(sizeof(DRAMAddr) * PATT_LEN);
+	h_patt.rounds = cfg->h_rounds;
+
+	for (int i = 0; i < BENCH_PATTS; i++) {
+		h_patt.len = 2 * (1 + rand() % 16);
+		for (size_t k = 0; k < h_patt.len; k++) {
+			h_patt.d_lst[k] = d_base;
+			h_patt.d_lst[k].row += 1 + rand() % (cfg->h_rows - 1);
+			h_patt.d_lst[k].bank = rand() % get_banks_cnt();
+		}
+		double acts[2];
+		for (int o = 0; o < 2; o++) {
+			p->reorder = o;
+			uint64_t t0 = realtime_now();
+			hammer_it(&h_patt, mem);
+			uint64_t dt = realtime_now() - t0;
+			acts[o] = (double)h_patt.len * h_patt.rounds * 1e9 / dt;
+			rate[o] += acts[o];
+		}
+		fprintf(stderr, "[LOG] - patt %02d (%2ld aggr): %.2f -> %.2f MACT/s (cost %ld -> %ld cycles)\n",
+			i, h_patt.len, acts[0] / 1e6, acts[1] / 1e6,
+			order_cost(m, &h_patt, NULL), order_accesses(m, &h_patt, order));
+	}
+	fprintf(stderr, "[LOG] - array order: %.2f MACT/s, timing order: %.2f MACT/s (%+.1f%%)\n",
+		rate[0] / BENCH_PATTS / 1e6, rate[1] / BENCH_PATTS / 1e6,
+		100.0 * (rate[1] - rate[0]) / rate[0]);
+
+	p->reorder = reorder;
+	free(h_patt.d_lst);
+}
@@ -71,7 +71,7 @@ void init_addr_mapper(ADDRMapper * mapper, MemoryBuffer * mem,
 
 void tear_down_addr_mapper(ADDRMapper * mapper)
 {
-	for (int i = 1; i < g_rows * g_bks; i++) {
+	for (int i = 0; i < g_rows * g_bks; i++) {
 		free(mapper->row_maps[i].lst);
 	}
 	free(mapper->row_maps);
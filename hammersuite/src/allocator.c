@@ -12,6 +12,7 @@
 #include <string.h>
 
 #include "utils.h"
+#include "placement.h"
 
 int alloc_buffer(MemoryBuffer * mem)
 {
@@ -24,7 +25,14 @@ int alloc_buffer(MemoryBuffer * mem)
 	}
 
 	uint64_t alloc_size = mem->align ? mem->size + mem->align : mem->size;
-	uint64_t alloc_flags = MAP_PRIVATE | MAP_POPULATE;
+	// a private buffer would be copied on the first write of a fleet
+	// worker, away from the frames the coordinator's physmap describes
+	uint64_t alloc_flags = (mem->flags & F_ALLOC_SHARED ? MAP_SHARED : MAP_PRIVATE) | MAP_POPULATE;
+
+	// pages have to be faulted in only after the policy is set
+	if (mem->flags & F_NUMA_BIND) {
+		alloc_flags &= ~MAP_POPULATE;
+	}
 
 	if (mem->flags & F_ALLOC_HUGE) {
 		if (mem->fd == 0) {
@@ -56,11 +64,23 @@ int alloc_buffer(MemoryBuffer * mem)
 		assert((uint64_t) mem->buffer % mem->align == 0);
 	}
 
+	if (mem->flags & F_NUMA_BIND) {
+		if (mem->node < 0)
+			mem->node = get_local_node();
+		if (bind_buffer(mem->buffer, mem->size, mem->node) == -1) {
+			exit(1);
+		}
+		for (uint64_t off = 0; off < mem->size; off += PAGE_SIZE) {
+			*(volatile char *)(mem->buffer + off) = 0;
+		}
+	}
+
 	if (mem->flags & F_VERBOSE) {
 		fprintf(stderr, "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
 		fprintf(stderr, "[ MEM ] - Buffer:      %p\n", mem->buffer);
 		fprintf(stderr, "[ MEM ] - Size:        %ld\n", alloc_size);
 		fprintf(stderr, "[ MEM ] - Alignment:   %ld\n", mem->align);
+		fprintf(stderr, "[ MEM ] - Node:        %d\n", get_buffer_node(mem));
 		fprintf(stderr, "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
 	}
 	return 0;
@@ -0,0 +1,299 @@
+#include "celldb.h"
+
+#include "params.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+CellDB *g_celldb = NULL;
+
+// log offset of the last pattern recorded by this process
+static DRAMAddr last_patt[PATT_LEN];
+static size_t last_len = 0;
+static uint64_t last_off = 0;
+
+static uint64_t hash_key(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return key;
+}
+
+int open_celldb(const char *f_name, CellDB * db)
+{
+	struct stat st;
+
+	db->size = sizeof(CellDBHeader) + CELLDB_SLOTS * sizeof(CellSlot)
+	    + CELLDB_ROWS * sizeof(RowSlot) + CELLDB_PWORDS * sizeof(uint64_t);
+	if ((db->fd = open(f_name, O_CREAT | O_RDWR, 0644)) == -1) {
+		perror("[ERROR] - Unable to open cell db");
+		return -1;
+	}
+	fstat(db->fd, &st);
+	bool fresh = st.st_size == 0;
+	// sparse, only the slots in use take space on disk
+	if (fresh && ftruncate(db->fd, db->size) == -1) {
+		perror("[ERROR] - Unable to size cell db");
+		close(db->fd);
+		return -1;
+	}
+	if (!fresh && (size_t)st.st_size != db->size) {
+		fprintf(stderr, "[ERROR] - %s is not a cell db\n", f_name);
+		close(db->fd);
+		return -1;
+	}
+
+	db->hdr = (CellDBHeader *) mmap(NULL, db->size, PROT_READ | PROT_WRITE,
+					MAP_SHARED, db->fd, 0);
+	if (db->hdr == MAP_FAILED) {
+		perror("[ERROR] - mmap() of cell db failed");
+		close(db->fd);
+		return -1;
+	}
+	db->slots = (CellSlot *) (db->hdr + 1);
+	db->rows = (RowSlot *) (db->slots + CELLDB_SLOTS);
+	db->p_log = (uint64_t *) (db->rows + CELLDB_ROWS);
+
+	if (fresh) {
+		db->hdr->magic = CELLDB_MAGIC;
+		db->hdr->slots = CELLDB_SLOTS;
+		db->hdr->cells = 0;
+		db->hdr->p_cap = CELLDB_PWORDS;
+		db->hdr->p_len = 1;
+		db->hdr->rows = CELLDB_ROWS;
+		db->hdr->banks = 0;
+		db->hdr->unindexed = 0;
+	} else if (db->hdr->magic != CELLDB_MAGIC || db->hdr->slots != CELLDB_SLOTS
+		   || db->hdr->p_cap != CELLDB_PWORDS || db->hdr->rows != CELLDB_ROWS) {
+		fprintf(stderr, "[ERROR] - %s is not a cell db\n", f_name);
+		close_celldb(db);
+		return -1;
+	}
+	last_len = 0;
+	last_off = 0;
+	return 0;
+}
+
+void close_celldb(CellDB * db)
+{
+	msync(db->hdr, db->size, MS_SYNC);
+	munmap(db->hdr, db->size);
+	close(db->fd);
+}
+
+// returns the row slot of key, claiming an empty one if needed, NULL if full
+static RowSlot *find_row(CellDB * db, uint64_t key, bool claim)
+{
+	uint64_t mask = db->hdr->rows - 1;
+
+	for (uint64_t i = 0, h = hash_key(key) & mask; i <= mask; i++, h = (h + 1) & mask) {
+		RowSlot *row = &db->rows[h];
+		uint64_t cur = __atomic_load_n(&row->key, __ATOMIC_ACQUIRE);
+		if (cur == key)
+			return row;
+		if (cur != 0)
+			continue;
+		if (!claim)
+			return NULL;
+		if (__atomic_compare_exchange_n(&row->key, &cur, key, false,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return row;
+		if (cur == key)
+			return row;
+	}
+	return NULL;
+}
+
+// pushes a new cell on the list of its row, cells are never removed
+static void index_cell(CellDB * db, CellSlot * slot, uint64_t key)
+{
+	uint64_t bank = CELL_BANK(key);
+	uint64_t banks = __atomic_load_n(&db->hdr->banks, __ATOMIC_RELAXED);
+	while (banks <= bank
+	       && !__atomic_compare_exchange_n(&db->hdr->banks, &banks, bank + 1, false,
+					       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) ;
+
+	RowSlot *row = find_row(db, ROW_KEY(bank, CELL_ROW(key)), true);
+	if (row == NULL) {
+		// queries fall back to walking the cells
+		__atomic_fetch_add(&db->hdr->unindexed, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	uint64_t idx = slot - db->slots + 1;
+	uint64_t head = __atomic_load_n(&row->head, __ATOMIC_ACQUIRE);
+	do {
+		__atomic_store_n(&slot->next, head, __ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&row->head, &head, idx, false,
+					      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+// returns the slot of key, claiming an empty one if needed, NULL if full
+static CellSlot *find_slot(CellDB * db, uint64_t key, bool claim)
+{
+	uint64_t mask = db->hdr->slots - 1;
+
+	for (uint64_t i = 0, h = hash_key(key) & mask; i <= mask; i++, h = (h + 1) & mask) {
+		CellSlot *slot = &db->slots[h];
+		uint64_t cur = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+		if (cur == key)
+			return slot;
+		if (cur != 0)
+			continue;
+		if (!claim)
+			return NULL;
+		if (__atomic_compare_exchange_n(&slot->key, &cur, key, false,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			__atomic_fetch_add(&db->hdr->cells, 1, __ATOMIC_RELAXED);
+			index_cell(db, slot, key);
+			return slot;
+		}
+		if (cur == key)
+			return slot;
+	}
+	return NULL;
+}
+
+// consecutive flips mostly come from the same pattern, log it only once
+static uint64_t log_pattern(CellDB * db, HammerPattern * h_patt)
+{
+	if (h_patt->len == last_len && last_off != 0
+	    && !memcmp(h_patt->d_lst, last_patt, sizeof(DRAMAddr) * last_len))
+		return last_off;
+
+	uint64_t off = __atomic_fetch_add(&db->hdr->p_len, h_patt->len + 1,
+					  __ATOMIC_RELAXED);
+	if (off + h_patt->len + 1 > db->hdr->p_cap) {
+		// full, cells are still counted
+		return 0;
+	}
+	db->p_log[off] = h_patt->len;
+	for (size_t i = 0; i < h_patt->len; i++)
+		db->p_log[off + 1 + i] = (h_patt->d_lst[i].bank << 32) | h_patt->d_lst[i].row;
+
+	last_len = h_patt->len < PATT_LEN ? h_patt->len : 0;
+	memcpy(last_patt, h_patt->d_lst, sizeof(DRAMAddr) * last_len);
+	last_off = off;
+	return off;
+}
+
+void celldb_add(CellDB * db, FlipVal * flip)
+{
+	uint8_t diff = flip->f_og ^ flip->f_new;
+	uint64_t now = time(NULL);
+	uint64_t p_off = 0;
+
+	if (flip->h_patt != NULL)
+		p_off = log_pattern(db, flip->h_patt);
+
+	for (int b = 0; b < 8; b++) {
+		if (!(diff & BIT_SET(b)))
+			continue;
+		uint64_t key = CELL_KEY(flip->d_vict.bank, flip->d_vict.row,
+					flip->d_vict.col, b);
+		CellSlot *slot = find_slot(db, key, true);
+		if (slot == NULL) {
+			fprintf(stderr, "[WARN] - Cell db full, flip dropped\n");
+			return;
+		}
+
+		uint8_t dir = (flip->f_og >> b) & 1 ? CELL_PULLDN : CELL_PULLUP;
+		uint64_t zero = 0;
+		__atomic_fetch_or(&slot->dirs, dir, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&slot->hits, 1, __ATOMIC_RELAXED);
+		__atomic_compare_exchange_n(&slot->first, &zero, now, false,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		__atomic_store_n(&slot->last, now, __ATOMIC_RELAXED);
+		if (p_off == 0)
+			continue;
+		zero = 0;
+		__atomic_compare_exchange_n(&slot->p_first, &zero, p_off, false,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		if (__atomic_exchange_n(&slot->p_last, p_off, __ATOMIC_RELAXED) != p_off)
+			__atomic_fetch_add(&slot->patts, 1, __ATOMIC_RELAXED);
+	}
+}
+
+CellSlot *celldb_get(CellDB * db, uint64_t bank, uint64_t row, uint64_t col,
+		     uint8_t bit)
+{
+	return find_slot(db, CELL_KEY(bank, row, col, bit), false);
+}
+
+static size_t query_row(CellDB * db, RowSlot * row,
+			void (*cb) (CellSlot * cell, void *arg), void *arg)
+{
+	size_t cnt = 0;
+
+	for (uint64_t i = __atomic_load_n(&row->head, __ATOMIC_ACQUIRE); i != 0; cnt++) {
+		CellSlot *slot = &db->slots[i - 1];
+		if (cb != NULL)
+			cb(slot, arg);
+		i = __atomic_load_n(&slot->next, __ATOMIC_ACQUIRE);
+	}
+	return cnt;
+}
+
+/*
+ Calls cb on every cell of bank (CELL_ANY_BANK for all of them) with
+ r_lo <= row < r_hi, returns the number of cells found. Small ranges
+ look every (bank, row) up in the row table, larger ones walk the row
+ table, which is much smaller than the cell table. Only a db whose row
+ table overflowed falls back to walking every cell.
+ */
+size_t celldb_query(CellDB * db, uint64_t bank, uint64_t r_lo, uint64_t r_hi,
+		    void (*cb) (CellSlot * cell, void *arg), void *arg)
+{
+	size_t cnt = 0;
+	uint64_t b_lo = bank == CELL_ANY_BANK ? 0 : bank;
+	uint64_t b_hi = bank == CELL_ANY_BANK ? __atomic_load_n(&db->hdr->banks, __ATOMIC_RELAXED) : bank + 1;
+
+	if (r_hi <= r_lo || b_hi <= b_lo)
+		return 0;
+	if (__atomic_load_n(&db->hdr->unindexed, __ATOMIC_RELAXED) == 0) {
+		if (r_hi - r_lo <= db->hdr->rows / (b_hi - b_lo)) {
+			for (uint64_t bk = b_lo; bk < b_hi; bk++) {
+				for (uint64_t r = r_lo; r < r_hi; r++) {
+					RowSlot *row = find_row(db, ROW_KEY(bk, r), false);
+					if (row != NULL)
+						cnt += query_row(db, row, cb, arg);
+				}
+			}
+			return cnt;
+		}
+		for (uint64_t i = 0; i < db->hdr->rows; i++) {
+			RowSlot *row = &db->rows[i];
+			uint64_t key = __atomic_load_n(&row->key, __ATOMIC_ACQUIRE);
+			if (key == 0)
+				continue;
+			if (bank != CELL_ANY_BANK && ((key >> 32) & 0x7fff) != bank)
+				continue;
+			if ((key & 0xffffffff) < r_lo || (key & 0xffffffff) >= r_hi)
+				continue;
+			cnt += query_row(db, row, cb, arg);
+		}
+		return cnt;
+	}
+
+	for (uint64_t i = 0; i < db->hdr->slots; i++) {
+		CellSlot *slot = &db->slots[i];
+		uint64_t key = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+		if (key == 0)
+			continue;
+		if (bank != CELL_ANY_BANK && CELL_BANK(key) != bank)
+			continue;
+		if (CELL_ROW(key) < r_lo || CELL_ROW(key) >= r_hi)
+			continue;
+		if (cb != NULL)
+			cb(slot, arg);
+		cnt++;
+	}
+	return cnt;
+}
@@ -0,0 +1,173 @@
+#include "conflict.h"
+
+#include "dram-address.h"
+#include "memory.h"
+#include "params.h"
+#include "utils.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern ProfileParams *p;
+
+typedef struct {
+	uint64_t k1, k2;	// bank << 32 | row, k1 < k2, 0 = empty
+	bool conflict;
+} ConflictSlot;
+
+static ConflictSlot cache[CONF_CACHE];
+static size_t cache_len = 0;
+static ConflictStats stats;
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+// median cycles of a1 and a2 read back to back, as in drama
+uint64_t time_tuple(volatile char *a1, volatile char *a2, size_t rounds)
+{
+	uint64_t *time_vals = (uint64_t *) calloc(rounds, sizeof(uint64_t));
+	uint64_t t0;
+
+	sched_yield();
+	for (size_t i = 0; i < rounds; i++) {
+		mfence();
+		t0 = rdtscp();
+		*a1;
+		*a2;
+		time_vals[i] = rdtscp() - t0;
+		lfence();
+		clflush(a1);
+		clflush(a2);
+	}
+	qsort(time_vals, rounds, sizeof(uint64_t), cmp_u64);
+	uint64_t mdn = time_vals[rounds / 2];
+	free(time_vals);
+	return mdn;
+}
+
+/*
+ Random pairs of the buffer mostly land on different banks: the conflicts
+ are the slow tail. The threshold goes in the widest gap above the median,
+ which does not depend on the layout being checked.
+ */
+static uint64_t conflict_threshold(MemoryBuffer * mem)
+{
+	uint64_t t[CONF_CALIB];
+
+	for (int i = 0; i < CONF_CALIB; i++) {
+		char *a1 = mem->buffer + ALIGN_TO((uint64_t) rand() % mem->size, CL_SHIFT);
+		char *a2 = mem->buffer + ALIGN_TO((uint64_t) rand() % mem->size, CL_SHIFT);
+		t[i] = time_tuple(a1, a2, CONF_CALIB_REPS);
+	}
+	qsort(t, CONF_CALIB, sizeof(uint64_t), cmp_u64);
+
+	size_t gap_i = CONF_CALIB / 2;
+	for (size_t i = CONF_CALIB / 2; i + 1 < CONF_CALIB; i++) {
+		if (t[i + 1] - t[i] > t[gap_i + 1] - t[gap_i])
+			gap_i = i;
+	}
+	uint64_t thresh = (t[gap_i] + t[gap_i + 1]) / 2;
+	fprintf(stderr, "[LOG] - Row conflict threshold: %ld cycles (median %ld, max %ld)\n",
+		thresh, t[CONF_CALIB / 2], t[CONF_CALIB - 1]);
+	return thresh;
+}
+
+static ConflictSlot *find_slot(uint64_t k1, uint64_t k2, bool * found)
+{
+	uint64_t mask = CONF_CACHE - 1;
+
+	if (cache_len == CONF_CACHE - 1) {
+		memset(cache, 0, sizeof(cache));
+		cache_len = 0;
+	}
+	for (uint64_t h = ((k1 * 31 + k2) * 0x9e3779b97f4a7c15ULL) >> 32 & mask;;
+	     h = (h + 1) & mask) {
+		ConflictSlot *slot = &cache[h];
+		if (slot->k1 == k1 && slot->k2 == k2) {
+			*found = true;
+			return slot;
+		}
+		if (slot->k1 == 0 && slot->k2 == 0) {
+			*found = false;
+			slot->k1 = k1;
+			slot->k2 = k2;
+			cache_len++;
+			return slot;
+		}
+	}
+}
+
+static bool rows_conflict(DRAMAddr * d1, DRAMAddr * d2, MemoryBuffer * mem)
+{
+	uint64_t k1 = (d1->bank << 32) | d1->row, k2 = (d2->bank << 32) | d2->row;
+	bool found;
+
+	if (k1 > k2) {
+		uint64_t tmp = k1;
+		k1 = k2;
+		k2 = tmp;
+	}
+	ConflictSlot *slot = find_slot(k1, k2, &found);
+	if (found)
+		return slot->conflict;
+
+	if (stats.thresh == 0)
+		stats.thresh = conflict_threshold(mem);
+	DRAMAddr a1 = *d1, a2 = *d2;
+	a1.col = a2.col = 0;
+	char *v1 = phys_2_virt(dram_2_phys(a1), mem);
+	char *v2 = phys_2_virt(dram_2_phys(a2), mem);
+	slot->conflict = time_tuple(v1, v2, CONF_REPS) >= stats.thresh;
+	stats.pairs++;
+	if (!slot->conflict) {
+		stats.fails++;
+		if (p->g_flags & F_VERBOSE)
+			fprintf(stderr, "[WARN] - No row conflict between b%02ld.r%06ld and b%02ld.r%06ld\n",
+				d1->bank, d1->row, d2->bank, d2->row);
+	}
+	return slot->conflict;
+}
+
+/*
+ Times every aggressor against the next one of the same bank (different
+ row) and returns the number of pairs that did not conflict, 0 when the
+ layout holds for the whole pattern.
+ */
+size_t check_conflicts(HammerPattern * h_patt, MemoryBuffer * mem)
+{
+	size_t fails = 0;
+
+	for (size_t i = 0; i < h_patt->len; i++) {
+		DRAMAddr *d1 = &h_patt->d_lst[i];
+		for (size_t j = i + 1; j < h_patt->len; j++) {
+			DRAMAddr *d2 = &h_patt->d_lst[j];
+			if (d2->bank != d1->bank || d2->row == d1->row)
+				continue;
+			fails += !rows_conflict(d1, d2, mem);
+			break;
+		}
+	}
+	return fails;
+}
+
+ConflictStats *get_conflict_stats()
+{
+	return &stats;
+}
+
+void export_conflict_stats()
+{
+	if (!p->conflicts || out_fd == NULL)
+		return;
+	double acc = stats.pairs ? 1.0 - (double)stats.fails / stats.pairs : 1.0;
+	fprintf(stderr, "[LOG] - Mapping accuracy: %ld/%ld aggressor pairs conflict (%.1f%%), %ld patterns skipped\n",
+		stats.pairs - stats.fails, stats.pairs, 100.0 * acc, stats.skipped);
+	fprintf(out_fd, "# { conflict_pairs: %ld, no_conflict: %ld, map_acc: %.4f, conflict_thresh: %ld, skipped: %ld }\n",
+		stats.pairs, stats.fails, acc, stats.thresh, stats.skipped);
+	fflush(out_fd);
+}
@@ -110,6 +110,98 @@ uint64_t get_banks_cnt()
 
 }
 
+// every bank, LS_BITMASK(64) would overflow
+uint64_t get_banks_mask()
+{
+	return get_banks_cnt() >= 64 ? ~0ULL : LS_BITMASK(get_banks_cnt());
+}
+
+// bits of the flat bank index selecting dim
+uint64_t get_dim_mask(DRAMDim dim)
+{
+	uint64_t mask = 0;
+	for (int i = 0; i < g_mem_layout.h_fns.len; i++) {
+		if (g_mem_layout.h_dims[i] == dim)
+			mask |= BIT_SET(i);
+	}
+	return mask;
+}
+
+// gathers the bank bits of dim, lsb first
+uint64_t dram_dim(DRAMAddr * d_addr, DRAMDim dim)
+{
+	uint64_t res = 0;
+	int pos = 0;
+	for (int i = 0; i < g_mem_layout.h_fns.len; i++) {
+		if (g_mem_layout.h_dims[i] != dim)
+			continue;
+		res |= ((d_addr->bank >> i) & 1) << pos++;
+	}
+	return res;
+}
+
+DRAMCoord dram_coord(DRAMAddr * d_addr)
+{
+	DRAMCoord res = {
+		.ch = dram_dim(d_addr, DIM_CH),
+		.rk = dram_dim(d_addr, DIM_RK),
+		.bg = dram_dim(d_addr, DIM_BG),
+		.bk = dram_dim(d_addr, DIM_BK)
+	};
+	return res;
+}
+
+// same channel, rank and bank group: back to back activations pay tRRD_L
+bool d_addr_eq_bg(DRAMAddr * d1, DRAMAddr * d2)
+{
+	uint64_t mask = get_banks_mask() & ~get_dim_mask(DIM_BK);
+	return ((d1->bank ^ d2->bank) & mask) == 0;
+}
+
+/*
+ Bank index bits in interleaving order: channel first, then bank group,
+ rank and bank, most significant first within a dimension. Without labels
+ this is plain msb first order.
+ */
+static int interleave_order(int *order)
+{
+	static const DRAMDim dims[] = { DIM_CH, DIM_BG, DIM_RK, DIM_BK };
+	int cnt = 0;
+	for (int d = 0; d < DIM_CNT; d++) {
+		for (int i = g_mem_layout.h_fns.len - 1; i >= 0; i--) {
+			if (g_mem_layout.h_dims[i] == dims[d])
+				order[cnt++] = i;
+		}
+	}
+	return cnt;
+}
+
+/*
+ idx-th bank in interleaving order relative to bank 0: consecutive
+ indexes land on a different channel (then bank group, rank) whenever the
+ layout has one, bk ^ bank_at(i) does the same relative to bk.
+ */
+uint64_t bank_at(uint64_t idx)
+{
+	int order[HASH_FN_CNT];
+	int cnt = interleave_order(order);
+	uint64_t bk = 0;
+	for (int j = 0; j < cnt; j++)
+		bk |= ((idx >> j) & 1) << order[j];
+	return bk;
+}
+
+// inverse of bank_at()
+uint64_t bank_idx(uint64_t bk)
+{
+	int order[HASH_FN_CNT];
+	int cnt = interleave_order(order);
+	uint64_t idx = 0;
+	for (int j = 0; j < cnt; j++)
+		idx |= ((bk >> order[j]) & 1) << j;
+	return idx;
+}
+
 char *dram_2_str(DRAMAddr * d_addr)
 {
 	static char ret_str[1024];
@@ -122,10 +214,18 @@ char *dram_2_str(DRAMAddr * d_addr)
 char *dramLayout_2_str(DRAMLayout * mem_layout)
 {
 	static char ret_str[1024];
-	sprintf(ret_str, "{0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx} - 0x%lx\n",
-		mem_layout->h_fns.lst[0], mem_layout->h_fns.lst[1],
-		mem_layout->h_fns.lst[2], mem_layout->h_fns.lst[3],
-		mem_layout->h_fns.lst[4], mem_layout->h_fns.lst[5],
-		mem_layout->row_mask);
+	static const char *dim_str[] = { "bk", "bg", "rk", "ch" };
+	char *s = ret_str;
+	s += sprintf(s, "{0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx} - 0x%lx",
+		     mem_layout->h_fns.lst[0], mem_layout->h_fns.lst[1],
+		     mem_layout->h_fns.lst[2], mem_layout->h_fns.lst[3],
+		     mem_layout->h_fns.lst[4], mem_layout->h_fns.lst[5],
+		     mem_layout->row_mask);
+	for (int i = 0; i < mem_layout->h_fns.len; i++) {
+		uint64_t dim = mem_layout->h_dims[i];
+		s += sprintf(s, "%s%s", i ? ", " : " - {",
+			     dim < DIM_CNT ? dim_str[dim] : "??");
+	}
+	sprintf(s, "%s\n", mem_layout->h_fns.len ? "}" : "");
 	return ret_str;
 }
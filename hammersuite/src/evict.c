@@ -0,0 +1,234 @@
+#include "evict.h"
+
+#include "evset.h"
+#include "dram-address.h"
+#include "memory.h"
+#include "utils.h"
+
+#include <cpuid.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *flush_str[FLUSH_CNT] = { "clflushopt", "clflush", "clwb", "evset" };
+const char *fence_str[FENCE_CNT] = { "round", "access", "none" };
+
+int str2flush(const char *str)
+{
+	if (strcmp(str, "auto") == 0)
+		return FLUSH_AUTO;
+	for (int i = 0; i < FLUSH_CNT; i++) {
+		if (strcmp(str, flush_str[i]) == 0)
+			return i;
+	}
+	return -2;
+}
+
+int str2fence(const char *str)
+{
+	for (int i = 0; i < FENCE_CNT; i++) {
+		if (strcmp(str, fence_str[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+// clflushopt and clwb fault where missing, CPUID.7.0:EBX bits 23 and 24
+bool flush_supported(int flush)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (flush == FLUSH_CLFLUSH || flush == FLUSH_EVSET)
+		return true;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	if (flush == FLUSH_CLWB)
+		return ebx & BIT_SET(24);
+	return ebx & BIT_SET(23);
+}
+
+static inline __attribute__ ((always_inline))
+void evict_line(char *v, int flush)
+{
+	switch (flush) {
+	case FLUSH_CLFLUSH:
+		clflush(v);
+		break;
+	case FLUSH_CLWB:
+		clwb(v);
+		break;
+	default:
+		clflushopt(v);
+		break;
+	}
+}
+
+/*
+ The round of hammer_it(): read every aggressor, then evict them all.
+ flush and fence are constants in every instance below, so each one is
+ compiled without any branch in the loop.
+ */
+static inline __attribute__ ((always_inline))
+void hammer_loop(char **v_lst, size_t len, size_t rounds, int flush, int fence)
+{
+	for (size_t i = 0; i < rounds; i++) {
+		if (fence == FENCE_ROUND)
+			mfence();
+		for (size_t j = 0; j < len; j++)
+			*(volatile char *)v_lst[j];
+		for (size_t j = 0; j < len; j++) {
+			evict_line(v_lst[j], flush);
+			if (fence == FENCE_ACCESS)
+				mfence();
+		}
+	}
+}
+
+#define HAMMER_LOOP(fl, fn) \
+static void hammer_loop_##fl##_##fn(char **v_lst, size_t len, size_t rounds) \
+{ \
+	hammer_loop(v_lst, len, rounds, fl, fn); \
+}
+
+HAMMER_LOOP(FLUSH_CLFLUSHOPT, FENCE_ROUND)
+HAMMER_LOOP(FLUSH_CLFLUSHOPT, FENCE_ACCESS)
+HAMMER_LOOP(FLUSH_CLFLUSHOPT, FENCE_NONE)
+HAMMER_LOOP(FLUSH_CLFLUSH, FENCE_ROUND)
+HAMMER_LOOP(FLUSH_CLFLUSH, FENCE_ACCESS)
+HAMMER_LOOP(FLUSH_CLFLUSH, FENCE_NONE)
+HAMMER_LOOP(FLUSH_CLWB, FENCE_ROUND)
+HAMMER_LOOP(FLUSH_CLWB, FENCE_ACCESS)
+HAMMER_LOOP(FLUSH_CLWB, FENCE_NONE)
+
+static const HammerLoop loops[FLUSH_EVSET][FENCE_CNT] = {
+	{hammer_loop_FLUSH_CLFLUSHOPT_FENCE_ROUND, hammer_loop_FLUSH_CLFLUSHOPT_FENCE_ACCESS,
+	 hammer_loop_FLUSH_CLFLUSHOPT_FENCE_NONE},
+	{hammer_loop_FLUSH_CLFLUSH_FENCE_ROUND, hammer_loop_FLUSH_CLFLUSH_FENCE_ACCESS,
+	 hammer_loop_FLUSH_CLFLUSH_FENCE_NONE},
+	{hammer_loop_FLUSH_CLWB_FENCE_ROUND, hammer_loop_FLUSH_CLWB_FENCE_ACCESS,
+	 hammer_loop_FLUSH_CLWB_FENCE_NONE},
+};
+
+HammerLoop get_hammer_loop(int flush, int fence)
+{
+	if (flush < 0 || flush >= FLUSH_EVSET || fence < 0 || fence >= FENCE_CNT)
+		return loops[FLUSH_CLFLUSHOPT][FENCE_ROUND];
+	return loops[flush][fence];
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+// median cycles of a load, from the cache if cached, else from DRAM
+static uint64_t load_lat(char *v, bool cached)
+{
+	uint64_t t[CAL_REPS];
+
+	for (int i = 0; i < CAL_REPS; i++) {
+		if (cached)
+			*(volatile char *)v;
+		else
+			clflush(v);
+		mfence();
+		uint64_t t0 = rdtscp();
+		*(volatile char *)v;
+		t[i] = rdtscp() - t0;
+	}
+	qsort(t, CAL_REPS, sizeof(uint64_t), cmp_u64);
+	return t[CAL_REPS / 2];
+}
+
+// halfway between a cached and an uncached load of v
+uint64_t cache_threshold(char *v)
+{
+	return (load_lat(v, true) + load_lat(v, false)) / 2;
+}
+
+/*
+ Fraction of the loads of a two aggressor round that go to DRAM with the
+ given primitives. rdtscp around the load orders it against the previous
+ instructions but not against a pending eviction, which is what lets a
+ missing fence show up as hits.
+ */
+static double miss_rate(char **v, int flush, int fence, uint64_t thresh)
+{
+	size_t miss = 0;
+
+	for (int i = 0; i < CAL_REPS; i++) {
+		if (fence == FENCE_ROUND)
+			mfence();
+		for (int j = 0; j < 2; j++) {
+			uint64_t t0 = rdtscp();
+			*(volatile char *)v[j];
+			miss += rdtscp() - t0 >= thresh;
+		}
+		for (int j = 0; j < 2; j++) {
+			evict_line(v[j], flush);
+			if (fence == FENCE_ACCESS)
+				mfence();
+		}
+	}
+	return (double)miss / (2 * CAL_REPS);
+}
+
+/*
+ Times every supported flush/fence combination on two rows of the same
+ bank and returns the fastest one whose loads still miss the cache at
+ least CAL_MISS_MIN of the time. Falls back to clflushopt/round, the
+ historical hammer loop.
+ */
+void evict_calibrate(MemoryBuffer * mem, int *flush, int *fence)
+{
+	DRAMAddr d_base = phys_2_dram(virt_2_phys(mem->buffer, mem));
+	char *v[2];
+	double best_ns = 0;
+
+	for (int r = 0; r < 2; r++) {
+		DRAMAddr d = {.bank = d_base.bank,.row = d_base.row + 1 + r,.col = 0 };
+		v[r] = phys_2_virt(dram_2_phys(d), mem);
+	}
+	uint64_t hit = load_lat(v[0], true);
+	uint64_t miss = load_lat(v[0], false);
+	uint64_t thresh = (hit + miss) / 2;
+	fprintf(stderr, "[LOG] - Load latency: %ld cycles cached, %ld uncached\n", hit, miss);
+
+	*flush = flush_supported(FLUSH_CLFLUSHOPT) ? FLUSH_CLFLUSHOPT : FLUSH_CLFLUSH;
+	*fence = FENCE_ROUND;
+	for (int fl = 0; fl < FLUSH_CNT; fl++) {
+		if (!flush_supported(fl)) {
+			fprintf(stderr, "[LOG] - %-10s: not supported\n", flush_str[fl]);
+			continue;
+		}
+		EvSet **sets = fl == FLUSH_EVSET ? get_evsets(v, 2, mem) : NULL;
+		for (int fn = 0; fn < FENCE_CNT; fn++) {
+			double rate;
+			uint64_t t0;
+			if (sets != NULL) {
+				rate = evset_miss_rate(v, sets, 2);
+				t0 = realtime_now();
+				evset_hammer(v, sets, 2, CAL_ROUNDS, fn);
+			} else {
+				rate = miss_rate(v, fl, fn, thresh);
+				t0 = realtime_now();
+				get_hammer_loop(fl, fn) (v, 2, CAL_ROUNDS);
+			}
+			double ns = (double)(realtime_now() - t0) / (2 * CAL_ROUNDS);
+			bool ok = rate >= CAL_MISS_MIN;
+			fprintf(stderr, "[LOG] - %-10s/%-6s: %6.1f ns/access, %5.1f%% misses%s\n",
+				flush_str[fl], fence_str[fn], ns, 100.0 * rate, ok ? "" : " (rejected)");
+			if (ok && (best_ns == 0 || ns < best_ns)) {
+				best_ns = ns;
+				*flush = fl;
+				*fence = fn;
+			}
+		}
+		if (sets != NULL)
+			evset_report(v, sets, 2);
+		free(sets);
+	}
+	fprintf(stderr, "[LOG] - Eviction: --flush %s --fence %s\n", flush_str[*flush],
+		fence_str[*fence]);
+}
@@ -0,0 +1,206 @@
+#include "evset.h"
+
+#include "evict.h"
+#include "params.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern ProfileParams *p;
+
+static EvSet cache[EV_CACHE];
+static size_t cache_len = 0;
+static EvStats stats;
+static uint64_t thresh = 0;	// cycles, a load at least this slow missed
+
+static inline __attribute__ ((always_inline))
+void walk(char **lst, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		*(volatile char *)lst[i];
+}
+
+// does walking lst push v out of the cache?
+static bool evicts(char *v, char **lst, size_t len)
+{
+	int miss = 0;
+
+	for (int t = 0; t < EV_TESTS; t++) {
+		*(volatile char *)v;
+		mfence();
+		walk(lst, len);
+		walk(lst, len);
+		mfence();
+		uint64_t t0 = rdtscp();
+		*(volatile char *)v;
+		miss += rdtscp() - t0 >= thresh;
+	}
+	return miss > EV_TESTS / 2;
+}
+
+// group testing reduction, lst is reduced in place
+static size_t reduce(char *v, char **lst, size_t len)
+{
+	char **tmp = (char **)malloc(sizeof(char *) * len);
+	size_t groups = EV_WAYS + 1;
+
+	while (len > EV_WAYS) {
+		bool found = false;
+		for (size_t g = 0; g < groups && !found; g++) {
+			size_t lo = len * g / groups, hi = len * (g + 1) / groups;
+			if (lo == hi)
+				continue;
+			size_t n = 0;
+			for (size_t i = 0; i < len; i++) {
+				if (i < lo || i >= hi)
+					tmp[n++] = lst[i];
+			}
+			if (evicts(v, tmp, n)) {
+				memcpy(lst, tmp, sizeof(char *) * n);
+				len = n;
+				found = true;
+			}
+		}
+		// every group is needed, as small as it gets without knowing the ways
+		if (!found)
+			break;
+	}
+	free(tmp);
+	return len;
+}
+
+static void build_evset(EvSet * es, char *v, MemoryBuffer * mem)
+{
+	char **lst = (char **)malloc(sizeof(char *) * EV_POOL);
+	size_t off = v - mem->buffer, n = 0;
+
+	// a hugepage buffer is contiguous, virtual strides are physical ones
+	for (size_t k = 1; n < EV_POOL && k < mem->size / EV_STRIDE; k++)
+		lst[n++] = mem->buffer + (off + k * EV_STRIDE) % mem->size;
+
+	uint64_t t0 = realtime_now();
+	if (thresh == 0)
+		thresh = cache_threshold(v);
+	n = evicts(v, lst, n) ? reduce(v, lst, n) : 0;
+	uint64_t dt = realtime_now() - t0;
+
+	es->lst = (char **)realloc(lst, sizeof(char *) * (n ? n : 1));
+	es->len = n;
+	stats.build_ns += dt;
+	if (n == 0) {
+		stats.failed++;
+		fprintf(stderr, "[WARN] - No eviction set for %p, it will not be evicted\n", v);
+		return;
+	}
+	stats.sets++;
+	stats.lines += n;
+	if (p->g_flags & F_VERBOSE)
+		fprintf(stderr, "[LOG] - Eviction set for %p: %ld lines (%.1f ms)\n", v, n, dt / 1e6);
+}
+
+EvSet *get_evset(char *v, MemoryBuffer * mem)
+{
+	uintptr_t key = (uintptr_t) v >> CL_SHIFT;
+	uint64_t mask = EV_CACHE - 1;
+
+	// keep a free slot for the probe to stop on, see get_evsets()
+	if (cache_len == EV_CACHE - 1)
+		free_evsets();
+	for (uint64_t h = (key * 0x9e3779b97f4a7c15ULL) >> 32 & mask;; h = (h + 1) & mask) {
+		EvSet *es = &cache[h];
+		if (es->key == key)
+			return es;
+		if (es->key != 0)
+			continue;
+		es->key = key;
+		cache_len++;
+		build_evset(es, v, mem);
+		return es;
+	}
+}
+
+/*
+ Sets of every aggressor, the array is the caller's to free. The cache is
+ only flushed here, before the first lookup, so the sets of the earlier
+ aggressors are never freed under the array.
+ */
+EvSet **get_evsets(char **v_lst, size_t len, MemoryBuffer * mem)
+{
+	assert(len < EV_CACHE);
+	if (cache_len + len > EV_CACHE - 1)
+		free_evsets();
+	EvSet **sets = (EvSet **) malloc(sizeof(EvSet *) * len);
+	for (size_t i = 0; i < len; i++)
+		sets[i] = get_evset(v_lst[i], mem);
+	return sets;
+}
+
+void free_evsets()
+{
+	for (size_t h = 0; h < EV_CACHE; h++) {
+		if (cache[h].key != 0)
+			free(cache[h].lst);
+	}
+	memset(cache, 0, sizeof(cache));
+	cache_len = 0;
+}
+
+// the round of hammer_it() with the sets walked instead of the lines flushed
+void evset_hammer(char **v_lst, EvSet ** sets, size_t len, size_t rounds, int fence)
+{
+	for (size_t i = 0; i < rounds; i++) {
+		if (fence == FENCE_ROUND)
+			mfence();
+		for (size_t j = 0; j < len; j++)
+			*(volatile char *)v_lst[j];
+		for (size_t j = 0; j < len; j++) {
+			walk(sets[j]->lst, sets[j]->len);
+			if (fence == FENCE_ACCESS)
+				mfence();
+		}
+	}
+}
+
+// fraction of the aggressor loads that went to DRAM over EV_SAMPLE rounds
+double evset_miss_rate(char **v_lst, EvSet ** sets, size_t len)
+{
+	size_t miss = 0;
+
+	if (thresh == 0 && len > 0)
+		thresh = cache_threshold(v_lst[0]);
+	for (int i = 0; i < EV_SAMPLE; i++) {
+		for (size_t j = 0; j < len; j++) {
+			uint64_t t0 = rdtscp();
+			*(volatile char *)v_lst[j];
+			miss += rdtscp() - t0 >= thresh;
+		}
+		for (size_t j = 0; j < len; j++)
+			walk(sets[j]->lst, sets[j]->len);
+	}
+	return len ? (double)miss / (EV_SAMPLE * len) : 0.0;
+}
+
+// eviction loads per aggressor access that reached DRAM
+double evset_report(char **v_lst, EvSet ** sets, size_t len)
+{
+	size_t lines = 0;
+	for (size_t j = 0; j < len; j++)
+		lines += sets[j]->len;
+	double rate = evset_miss_rate(v_lst, sets, len);
+	double ev_act = rate > 0 ? lines / (len * rate) : 0.0;
+
+	fprintf(stderr, "[LOG] - Eviction sets: %.1f evictions/ACT, %.1f%% of the aggressor loads activate"
+		" (%ld sets, %.1f lines avg, %ld failed, %.1f ms to build)\n",
+		ev_act, 100.0 * rate, stats.sets,
+		stats.sets ? (double)stats.lines / stats.sets : 0.0, stats.failed,
+		stats.build_ns / 1e6);
+	return ev_act;
+}
+
+EvStats *get_evset_stats()
+{
+	return &stats;
+}
@@ -0,0 +1,169 @@
+#include "fleet.h"
+
+#include "placement.h"
+#include "dram-address.h"
+#include "params.h"
+#include "utils.h"
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern ProfileParams *p;
+
+static FleetShm *g_fleet = NULL;
+static int g_worker = -1;
+
+// -1 in the coordinator or outside a fleet
+int fleet_worker_id()
+{
+	return g_worker;
+}
+
+// banks are dealt round-robin in interleaving order so that no two workers
+// share a bank and concurrent workers sit on different channels when possible
+uint64_t fleet_worker_banks(int worker)
+{
+	uint64_t banks = 0;
+	for (uint64_t idx = worker; idx < get_banks_cnt(); idx += g_fleet->workers)
+		banks |= BIT_SET(bank_at(idx));
+	return banks;
+}
+
+void fleet_on_flip(void *self, FlipVal * flip)
+{
+	__atomic_fetch_add(&g_fleet->flips, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&g_fleet->w[g_worker].flips, 1, __ATOMIC_RELAXED);
+}
+
+static char *worker_file(char *out_name, int worker)
+{
+	static char f_name[520];
+	sprintf(f_name, "%s.w%02d", out_name, worker);
+	return f_name;
+}
+
+// one core per worker, cpu0 only if there is nothing else
+static int worker_cpu(int worker)
+{
+	Placement *pl = get_placement();
+	int skip = pl->cpu_cnt > 1 && pl->cpus[0] == 0;
+
+	if (pl->cpu_cnt - skip <= 0)
+		return -1;
+	return pl->cpus[skip + worker % (pl->cpu_cnt - skip)];
+}
+
+static void run_worker(int worker, FleetJob job, void *arg, char *out_name)
+{
+	Placement *pl = get_placement();
+
+	g_worker = worker;
+	g_fleet->w[worker].pid = getpid();
+	g_fleet->w[worker].cpu = worker_cpu(worker);
+	if (g_fleet->w[worker].cpu != -1 && pin_to_cpu(g_fleet->w[worker].cpu) == 0) {
+		pl->hammer_cpu = g_fleet->w[worker].cpu;
+		pl->scan_cpu = g_fleet->w[worker].cpu;
+	} else {
+		g_fleet->w[worker].cpu = -1;
+	}
+
+	// the parent stream is only written by the coordinator
+	out_fd = fopen(worker_file(out_name, worker), "w+");
+	if (out_fd == NULL) {
+		perror("[ERROR] - Unable to open worker file");
+		_exit(1);
+	}
+
+	// a job handed to a single worker would leave the other banks out
+	for (uint64_t j = 0; j < g_fleet->n_jobs; j++) {
+		job(worker, j, arg);
+		__atomic_fetch_add(&g_fleet->w[worker].jobs, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&g_fleet->jobs_done, 1, __ATOMIC_RELAXED);
+	}
+	fclose(out_fd);
+	_exit(0);
+}
+
+// appends the worker files to out_fd, in worker order
+static void merge_output(char *out_name, int workers)
+{
+	char buf[4096];
+	size_t len;
+
+	for (int i = 0; i < workers; i++) {
+		char *f_name = worker_file(out_name, i);
+		FILE *fp = fopen(f_name, "r");
+		if (fp == NULL)
+			continue;
+		fprintf(out_fd, "# { worker: %d, cpu: %d, jobs: %ld, flips: %ld }\n", i,
+			g_fleet->w[i].cpu, g_fleet->w[i].jobs, g_fleet->w[i].flips);
+		while ((len = fread(buf, 1, sizeof(buf), fp)) > 0)
+			fwrite(buf, 1, len, out_fd);
+		fclose(fp);
+		unlink(f_name);
+	}
+	fflush(out_fd);
+}
+
+/*
+ Forks --fleet workers that each run every job on their own banks, each
+ pinned to its own core of the buffer node and writing to its own file. The
+ coordinator reports the shared counters while waiting and merges every
+ worker file into out_fd once they are all done. The buffer, physmap and
+ anything else set up before the call are inherited by the workers.
+ */
+FleetShm *fleet_run(uint64_t n_jobs, FleetJob job, void *arg, char *out_name)
+{
+	int workers = p->fleet < FLEET_MAX ? p->fleet : FLEET_MAX;
+
+	g_fleet = (FleetShm *) mmap(NULL, sizeof(FleetShm), PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (g_fleet == MAP_FAILED) {
+		perror("[ERROR] - mmap() of fleet counters failed");
+		exit(1);
+	}
+	memset(g_fleet, 0x00, sizeof(FleetShm));
+	g_fleet->n_jobs = n_jobs;
+	g_fleet->workers = workers;
+
+	fflush(out_fd);
+	fflush(stderr);
+	for (int i = 0; i < workers; i++) {
+		pid_t pid = fork();
+		if (pid == -1) {
+			perror("[ERROR] - fork() failed");
+			exit(1);
+		}
+		if (pid == 0)
+			run_worker(i, job, arg, out_name);
+		g_fleet->w[i].pid = pid;
+	}
+
+	int alive = workers, status;
+	while (alive > 0) {
+		pid_t pid = waitpid(-1, &status, WNOHANG);
+		if (pid > 0) {
+			alive--;
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				fprintf(stderr, "[WARN] - Worker %d failed\n", pid);
+			continue;
+		}
+		if (pid == -1)
+			break;
+		sleep(1);
+		if (p->g_flags & F_VERBOSE)
+			fprintf(stderr, "[FLEET] - %ld/%ld jobs, %ld flips\n",
+				__atomic_load_n(&g_fleet->jobs_done, __ATOMIC_RELAXED), n_jobs * workers,
+				__atomic_load_n(&g_fleet->flips, __ATOMIC_RELAXED));
+	}
+
+	merge_output(out_name, workers);
+	fprintf(stderr, "[LOG] - Fleet over: %d workers, %ld/%ld jobs, %ld flips\n",
+		workers, g_fleet->jobs_done, n_jobs * workers, g_fleet->flips);
+	return g_fleet;
+}
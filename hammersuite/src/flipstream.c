@@ -0,0 +1,87 @@
+#include "flipstream.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+FlipRing *g_flipring = NULL;
+
+static char shm_name[256];
+static uint64_t cur_patt = 0;	// per process, fleet workers hammer their own
+
+int open_flipstream(const char *name)
+{
+	if (name == NULL) {
+		sprintf(shm_name, "%s%d", FS_PREFIX, getpid());
+	} else {
+		snprintf(shm_name, sizeof(shm_name), "%s%s", name[0] == '/' ? "" : "/", name);
+	}
+
+	int fd = shm_open(shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd == -1) {
+		perror("[ERROR] - shm_open() of flip stream failed");
+		return -1;
+	}
+	if (ftruncate(fd, sizeof(FlipRing)) == -1) {
+		perror("[ERROR] - Unable to size flip stream");
+		close(fd);
+		return -1;
+	}
+	g_flipring = (FlipRing *) mmap(NULL, sizeof(FlipRing), PROT_READ | PROT_WRITE,
+				       MAP_SHARED, fd, 0);
+	close(fd);
+	if (g_flipring == MAP_FAILED) {
+		perror("[ERROR] - mmap() of flip stream failed");
+		g_flipring = NULL;
+		return -1;
+	}
+
+	// fresh from ftruncate, all the slots are still unpublished
+	g_flipring->pid = getpid();
+	g_flipring->cap = FS_CAP;
+	__atomic_store_n(&g_flipring->magic, FS_MAGIC, __ATOMIC_RELEASE);
+	fprintf(stderr, "[LOG] - Flip stream: /dev/shm%s (%d events)\n", shm_name, FS_CAP);
+	return 0;
+}
+
+void close_flipstream()
+{
+	if (g_flipring == NULL)
+		return;
+	munmap(g_flipring, sizeof(FlipRing));
+	shm_unlink(shm_name);
+	g_flipring = NULL;
+}
+
+void flipstream_pattern()
+{
+	if (g_flipring == NULL)
+		return;
+	cur_patt = __atomic_fetch_add(&g_flipring->patterns, 1, __ATOMIC_RELAXED);
+}
+
+void flipstream_push(FlipVal * flip)
+{
+	if (g_flipring == NULL)
+		return;
+
+	uint64_t i = __atomic_fetch_add(&g_flipring->head, 1, __ATOMIC_RELAXED);
+	FlipEvent *ev = &g_flipring->ev[i & (FS_CAP - 1)];
+
+	__atomic_store_n(&ev->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	ev->patt = cur_patt;
+	ev->bank = flip->d_vict.bank;
+	ev->row = flip->d_vict.row;
+	ev->col = flip->d_vict.col;
+	ev->exp = flip->f_og;
+	ev->got = flip->f_new;
+	ev->bits = flip->f_og ^ flip->f_new;
+	ev->up = ~flip->f_og & flip->f_new;
+	__atomic_store_n(&ev->seq, i + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,157 @@
+#include "hammer-server.h"
+
+#include "hammer-suite.h"
+#include "pattern-spec.h"
+#include "dram-address.h"
+#include "addr-mapper.h"
+#include "memory.h"
+#include "params.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+/*
+ Jobs are single pattern spec lines (see pattern-spec.h), e.g.
+
+	rows=0,2,4 banks=all rounds=1000000 data=random
+
+ "quit" closes the connection, "shutdown" stops the daemon.
+ Results are streamed back in the fliptable format, one line per bank,
+ followed by "# ok {...}" or "# error: ..." once the job is over.
+ */
+
+#define BACKLOG		4
+
+extern ProfileParams *p;
+
+static int open_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "[ERROR] - Socket path too long: %s\n", path);
+		return -1;
+	}
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("[ERROR] - Unable to create socket");
+		return -1;
+	}
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		perror("[ERROR] - Unable to bind socket");
+		close(fd);
+		return -1;
+	}
+	// tester runs as root, drivers usually don't
+	chmod(path, 0666);
+	if (listen(fd, BACKLOG) == -1) {
+		perror("[ERROR] - Unable to listen on socket");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// returns 1 if the daemon has to shut down
+static int serve_client(HammerSuite * suite, int c_fd)
+{
+	char *line = (char *)malloc(SPEC_LINE_LEN);
+	char err[128];
+	int shutdown = 0;
+	SpecEntry job;
+
+	job.h_patt.d_lst = (DRAMAddr *) malloc(sizeof(DRAMAddr) * PATT_LEN);
+
+	FILE *in = fdopen(c_fd, "r");
+	out_fd = fdopen(dup(c_fd), "w");
+	assert(in != NULL && out_fd != NULL);
+
+	fprintf(out_fd,
+		"# hello { base_row: %ld, h_rows: %ld, banks: %ld, h_rounds: %ld }\n",
+		suite->d_base.row, suite->cfg->h_rows, get_banks_cnt(),
+		suite->cfg->h_rounds);
+	fflush(out_fd);
+
+	while (fgets(line, SPEC_LINE_LEN, in) != NULL) {
+		if (strncmp(line, "quit", 4) == 0)
+			break;
+		if (strncmp(line, "shutdown", 8) == 0) {
+			shutdown = 1;
+			break;
+		}
+
+		int res = parse_spec_line(line, &job, suite, err);
+		if (res == 1)
+			continue;
+		if (res == -1) {
+			fprintf(out_fd, "# error: %s\n", err);
+			fflush(out_fd);
+			continue;
+		}
+		if (p->g_flags & F_VERBOSE) {
+			fprintf(stderr, "[JOB] - %s\n", hPatt_2_str(&job.h_patt, ROW_FIELD));
+		}
+		uint64_t time = run_spec_entry(suite, &job);
+		fprintf(out_fd, "# ok { banks: %d, time: %ld }\n",
+			__builtin_popcountl(job.banks), time);
+		fflush(out_fd);
+	}
+
+	fclose(out_fd);
+	fclose(in);
+	out_fd = NULL;
+	free(job.h_patt.d_lst);
+	free(line);
+	return shutdown;
+}
+
+void serve_session(SessionConfig * cfg, MemoryBuffer * mem)
+{
+	DRAMAddr d_base = phys_2_dram(virt_2_phys(mem->buffer, mem));
+	d_base.row += cfg->base_off;
+	d_base.col = 0;
+
+	HammerSuite *suite = new_suite(cfg, mem, d_base);
+	suite->mapper = (ADDRMapper *) malloc(sizeof(ADDRMapper));
+	init_addr_mapper(suite->mapper, mem, &suite->d_base, cfg->h_rows);
+	init_chunk(suite);
+
+	int s_fd = open_socket(p->sock_path);
+	if (s_fd == -1)
+		exit(1);
+
+	// a client going away mid-job must not take the daemon down
+	signal(SIGPIPE, SIG_IGN);
+	fprintf(stderr, "[LOG] - Serving hammer jobs on %s\n", p->sock_path);
+
+	while (1) {
+		int c_fd = accept(s_fd, NULL, NULL);
+		if (c_fd == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("[ERROR] - accept() failed");
+			break;
+		}
+		if (serve_client(suite, c_fd))
+			break;
+	}
+
+	close(s_fd);
+	unlink(p->sock_path);
+	tear_down_addr_mapper(suite->mapper);
+	free(suite);
+}
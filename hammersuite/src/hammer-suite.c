@@ -6,6 +6,20 @@
 #include "include/dram-address.h"
 #include "include/addr-mapper.h"
 #include "include/params.h"
+#include "include/placement.h"
+#include "include/pattern-spec.h"
+#include "include/celldb.h"
+#include "include/patt-set.h"
+#include "include/access-order.h"
+#include "include/evict.h"
+#include "include/evset.h"
+#include "include/conflict.h"
+#include "include/rt.h"
+#include "include/trace.h"
+#include "include/metrics.h"
+#include "include/flipstream.h"
+#include "include/perf.h"
+#include "include/patt-queue.h"
 
 #include <assert.h>
 #include <sys/types.h>
@@ -21,14 +35,8 @@
 #include <limits.h>
 #include <math.h>
 
-#define REFRESH_VAL "stdrefi"
 #define OUT_HEAD "f_og, f_new, vict_addr, aggr_addr\n"
 
-#define ROW_FIELD 		1
-#define COL_FIELD 		1<<1
-#define BK_FIELD 		1<<2
-#define P_FIELD			1<<3
-#define ALL_FIELDS		(ROW_FIELD | COL_FIELD | BK_FIELD)
 #define FLIPTABLE
 
 /*
@@ -59,6 +67,44 @@ extern ProfileParams *p;
 int g_bk;
 FILE *out_fd            = NULL;
 static uint64_t CL_SEED = 0x7bc661612e71168c;
+static ScanStats g_scan;
+// measured cost of a single aggressor access, see budget_rounds()
+static double g_acc_ns = 0.0;
+// cost of an access in the hammer windows of the last hammer_segmented(),
+// 0 if it did not hammer (conflict skip)
+static double g_last_acc_ns = 0.0;
+// hammering time of the last hammer_it(), without translation, evsets or setup
+static uint64_t g_window_ns = 0;
+// flips reported so far, see fuzz_banks()
+static size_t g_flips = 0;
+// successive halving of the fuzzed banks, see fuzz_banks()
+static struct {
+	size_t patterns;
+	size_t full;		// patterns that got to every bank
+	size_t windows;		// bank windows hammered
+	size_t saved;		// bank windows skipped
+} g_halving;
+// rounds to the first flip of the attack being written, since the last
+// victim check and overall, see hammer_segmented()
+static size_t g_min_rounds = 0;
+static size_t g_total_rounds = 0;
+// last hammering parameters written to out_fd, see export_session()
+static size_t g_out_rounds = 0;
+static int g_out_d_cfg = -1;
+// aggressors of the pattern being hammered translated ahead, see PattQueue
+static struct {
+	DRAMAddr *d_lst;
+	char **v_lst;
+} g_ready = { NULL, NULL };
+// the last pattern hammer_it() translated itself, reused by its segments and probes
+static struct {
+	DRAMAddr *d_lst;	// copy of the aggressors, the key
+	char **v_lst;		// the same translated, in hammer order
+	size_t len;
+	size_t cap;
+	int reorder;
+	MemoryBuffer *mem;
+} g_order = { NULL, NULL, 0, 0, 0, NULL };
 
 static inline __attribute((always_inline))
 char *cl_rand_gen(DRAMAddr * d_addr)
@@ -73,44 +119,22 @@ char *cl_rand_gen(DRAMAddr * d_addr)
 	return (char *)cl_buff;
 }
 
-typedef struct {
-	DRAMAddr *d_lst;
-	size_t len;
-	size_t rounds;
-} HammerPattern;
-
-typedef struct {
-	DRAMAddr d_vict;
-	uint8_t f_og;
-	uint8_t f_new;
-	HammerPattern *h_patt;
-} FlipVal;
-
-typedef struct {
-	MemoryBuffer *mem;
-	SessionConfig *cfg;
-	DRAMAddr d_base;	// base address for hammering
-	ADDRMapper *mapper;	// dram mapper
-
-	int (*hammer_test) (void *self);
-} HammerSuite;
-
 char *dAddr_2_str(DRAMAddr d_addr, uint8_t fields)
 {
 	static char ret_str[64];
-	char tmp_str[10];
+	char tmp_str[21];
 	bool first = true;
 	memset(ret_str, 0x00, 64);
 	if (fields & ROW_FIELD) {
 		first = false;
-		sprintf(tmp_str, "r%05ld", d_addr.row);
+		snprintf(tmp_str, sizeof(tmp_str), "r%05ld", d_addr.row);
 		strcat(ret_str, tmp_str);
 	}
 	if (fields & BK_FIELD) {
 		if (!first) {
 			strcat(ret_str, ".");
 		}
-		sprintf(tmp_str, "bk%02ld", d_addr.bank);
+		snprintf(tmp_str, sizeof(tmp_str), "bk%02ld", d_addr.bank);
 		strcat(ret_str, tmp_str);
 		first = false;
 	}
@@ -118,33 +142,46 @@ char *dAddr_2_str(DRAMAddr d_addr, uint8_t fields)
 		if (!first) {
 			strcat(ret_str, ".");
 		}
-		sprintf(tmp_str, "col%04ld", d_addr.col);
+		snprintf(tmp_str, sizeof(tmp_str), "col%04ld", d_addr.col);
 		strcat(ret_str, tmp_str);
 		first = false;
 	}
 	return ret_str;
 }
 
+// grows with the pattern, spec and daemon patterns go up to PATT_LEN rows
 char *hPatt_2_str(HammerPattern * h_patt, int fields)
 {
-	static char patt_str[256];
-	char *dAddr_str;
-
-	memset(patt_str, 0x00, 256);
-
-	for (int i = 0; i < h_patt->len; i++) {
-		dAddr_str = dAddr_2_str(h_patt->d_lst[i], fields);
-		strcat(patt_str, dAddr_str);
-		if (i + 1 != h_patt->len) {
-			strcat(patt_str, "/");
+	static char *patt_str = NULL;
+	static size_t cap = 0;
+	// dAddr_2_str() fits in 64 bytes, plus the separator
+	size_t need = h_patt->len * 65 + 1;
+	size_t off = 0;
+
+	if (need > cap) {
+		patt_str = (char *)realloc(patt_str, need);
+		if (patt_str == NULL) {
+			fprintf(stderr, "[ERROR] - Unable to allocate the pattern string\n");
+			exit(1);
 		}
+		cap = need;
+	}
+	patt_str[0] = '\0';
 
+	for (size_t i = 0; i < h_patt->len; i++) {
+		off += snprintf(patt_str + off, cap - off, "%s%s",
+				dAddr_2_str(h_patt->d_lst[i], fields),
+				i + 1 != h_patt->len ? "/" : "");
 	}
 	return patt_str;
 }
 
 void print_start_attack(HammerPattern *h_patt)
 {
+	if (h_patt->rounds != g_out_rounds) {
+		g_out_rounds = h_patt->rounds;
+		fprintf(out_fd, "# { h_rounds: %ld }\n", g_out_rounds);
+	}
 	fprintf(out_fd, "%s : ", hPatt_2_str(h_patt, ROW_FIELD | BK_FIELD));
 	fflush(out_fd);
 }
@@ -152,11 +189,19 @@ void print_start_attack(HammerPattern *h_patt)
 void print_end_attack()
 {
 	fprintf(out_fd, "\n");
+	if (g_min_rounds) {
+		fprintf(out_fd, "# { min_rounds: %ld, total_rounds: %ld }\n", g_min_rounds,
+			g_total_rounds);
+		g_min_rounds = 0;
+		g_total_rounds = 0;
+	}
+	export_perf_pattern();
 	fflush(out_fd);
 }
 
 void export_flip(FlipVal * flip)
 {
+	g_flips++;
 	if (p->g_flags & F_VERBOSE) {
 		fprintf(stdout, "[FLIP] - (%02x => %02x)\t vict: %s \taggr: %s \n",
 				flip->f_og, flip->f_new, dAddr_2_str(flip->d_vict, ALL_FIELDS),
@@ -173,6 +218,17 @@ void export_flip(FlipVal * flip)
 					ROW_FIELD | BK_FIELD | P_FIELD));
 #endif
 	fflush(out_fd);
+	if (g_celldb != NULL)
+		celldb_add(g_celldb, flip);
+	metrics_flip(flip);
+	flipstream_push(flip);
+}
+
+void report_flip(HammerSuite * suite, FlipVal * flip)
+{
+	export_flip(flip);
+	if (suite->on_flip != NULL)
+		suite->on_flip(suite, flip);
 }
 
 void export_cfg(HammerSuite * suite)
@@ -196,6 +252,37 @@ void export_cfg(HammerSuite * suite)
 	fflush(out_fd);
 }
 
+// node/core placement is recorded with every result file
+void export_placement()
+{
+	fprintf(out_fd, "# { %s }\n", placement_2_str(get_placement()));
+	fflush(out_fd);
+}
+
+/*
+ Parameters needed to re-run the patterns of the file. Later changes are
+ written as partial "# { key: val }" lines when they happen.
+ */
+void export_session(SessionConfig * cfg)
+{
+	g_out_rounds = cfg->h_rounds;
+	g_out_d_cfg = cfg->d_cfg;
+	fprintf(out_fd, "# { h_rounds: %ld, d_cfg: %s, seed: 0x%lx, flush: %s, fence: %s }\n",
+		cfg->h_rounds, data_str[cfg->d_cfg], CL_SEED, flush_str[p->flush],
+		fence_str[p->fence]);
+	fflush(out_fd);
+}
+
+uint64_t get_cl_seed()
+{
+	return CL_SEED;
+}
+
+void set_cl_seed(uint64_t seed)
+{
+	CL_SEED = seed;
+}
+
 void swap(char **lst, int i, int j)
 {
 	char *tmp = lst[i];
@@ -209,44 +296,201 @@ int random_int(int min, int max)
 	return number;
 }
 
-uint64_t hammer_it(HammerPattern* patt, MemoryBuffer* mem) {
+static inline void hammer_rounds(HammerLoop loop, EvSet** sets, char** v_lst, size_t len,
+				 size_t rounds)
+{
+	if (sets != NULL)
+		evset_hammer(v_lst, sets, len, rounds, p->fence);
+	else
+		loop(v_lst, len, rounds);
+}
 
-	char** v_lst = (char**) malloc(sizeof(char*)*patt->len);
-	for (size_t i = 0; i < patt->len; i++) {
-		v_lst[i] = phys_2_virt(dram_2_phys(patt->d_lst[i]), mem);
+/*
+ Aggressors of patt translated in hammer order. The access order and the
+ translation are computed once per pattern and bank: the segments, the
+ budget probe and any rerun of the same aggressors find them in g_order.
+ */
+static char **order_pattern(HammerPattern * patt, MemoryBuffer * mem)
+{
+	if (g_order.len == patt->len && g_order.reorder == p->reorder && g_order.mem == mem
+	    && !memcmp(g_order.d_lst, patt->d_lst, sizeof(DRAMAddr) * patt->len))
+		return g_order.v_lst;
+
+	if (g_order.cap < patt->len) {
+		g_order.cap = patt->len;
+		g_order.d_lst = (DRAMAddr *) realloc(g_order.d_lst, sizeof(DRAMAddr) * g_order.cap);
+		g_order.v_lst = (char **)realloc(g_order.v_lst, sizeof(char *) * g_order.cap);
+	}
+	size_t *order = NULL;
+	if (p->reorder) {
+		order = (size_t *) malloc(sizeof(size_t) * patt->len);
+		order_accesses(get_lat_matrix(mem), patt, order);
 	}
+	for (size_t i = 0; i < patt->len; i++)
+		g_order.v_lst[i] = phys_2_virt(dram_2_phys(patt->d_lst[order ? order[i] : i]), mem);
+	free(order);
+	memcpy(g_order.d_lst, patt->d_lst, sizeof(DRAMAddr) * patt->len);
+	g_order.len = patt->len;
+	g_order.reorder = p->reorder;
+	g_order.mem = mem;
+	return g_order.v_lst;
+}
+
+uint64_t hammer_it(HammerPattern* patt, MemoryBuffer* mem) {
+
+	char** v_lst;
+	if (patt->d_lst != NULL && patt->d_lst == g_ready.d_lst)
+		v_lst = g_ready.v_lst;
+	else
+		v_lst = order_pattern(patt, mem);
+
+	uint64_t cl0, cl1;
+	HammerLoop loop = get_hammer_loop(p->flush, p->fence);
+	EvSet** sets = NULL;
+	if (p->flush == FLUSH_EVSET)
+		sets = get_evsets(v_lst, patt->len, mem);
 
 	sched_yield();
 	if (p->threshold > 0) {
 		uint64_t t0 = 0, t1 = 0;
-		// Threshold value depends on your system
+		// Threshold value depends on your system, one round of the first
+		// aggressor with the eviction of --flush
 		while (abs((int64_t) t1 - (int64_t) t0) < p->threshold) {
 			t0 = rdtscp();
-			*(volatile char *)v_lst[0];
-			clflushopt(v_lst[0]);
+			hammer_rounds(loop, sets, v_lst, 1, 1);
 			t1 = rdtscp();
 		}
 	}
-
-
-	uint64_t cl0, cl1;
-	cl0 = realtime_now();
-	for ( int i = 0; i < patt->rounds;  i++) {
-		mfence();
-		for (size_t j = 0; j < patt->len; j++) {
-			*(volatile char*) v_lst[j];
-		}
-		for (size_t j = 0; j < patt->len; j++) {
-			clflushopt(v_lst[j]);
+	PerfSample ps;
+	if (p->perf)
+		perf_begin(&ps);
+	if (p->rt || p->trace) {
+		// one round at a time to catch the gaps, else one trace sample at a time
+		size_t step = p->rt ? 1 : p->trace;
+		RTWindow w;
+		if (p->rt)
+			rt_enter(&w);
+		if (p->trace)
+			trace_begin();
+		cl0 = realtime_now();
+		for (size_t i = 0; i < patt->rounds; i += step) {
+			size_t n = patt->rounds - i < step ? patt->rounds - i : step;
+			hammer_rounds(loop, sets, v_lst, patt->len, n);
+			if (p->rt)
+				rt_tick(&w);
+			if (p->trace && (i + n) % p->trace == 0)
+				trace_tick();
 		}
+		cl1 = realtime_now();
+		if (p->trace)
+			trace_end(patt, patt->rounds);
+		if (p->rt)
+			rt_leave(&w);
+	} else {
+		cl0 = realtime_now();
+		hammer_rounds(loop, sets, v_lst, patt->len, patt->rounds);
+		cl1 = realtime_now();
+	}
+	g_window_ns = cl1 - cl0;
+	if (p->perf) {
+		perf_end(&ps, PERF_HAMMER, patt->rounds, patt->len);
+		if (p->g_flags & F_VERBOSE)
+			fprintf(stderr, "[PERF] - cycles: %ld, instr: %ld, llc_miss: %ld (%.2f/round), dtlb_miss: %ld, dram_rd: %ld\n",
+				ps.val[PERF_CYCLES], ps.val[PERF_INSTR], ps.val[PERF_LLC_MISS],
+				(double)ps.val[PERF_LLC_MISS] / patt->rounds, ps.val[PERF_DTLB_MISS],
+				ps.val[PERF_DRAM_RD]);
 	}
-	cl1 = realtime_now();
+	if (sets != NULL && (p->g_flags & F_VERBOSE))
+		evset_report(v_lst, sets, patt->len);
+	free(sets);
+	metrics_hammer(patt, patt->rounds, cl1 - cl0);
 
-	free(v_lst);
 	return (cl1-cl0) / 1000000;
 
 }
 
+typedef struct {
+	uint64_t row;
+	size_t idx;
+} RowIdx;
+
+static int row_idx_cmp(const void *a, const void *b)
+{
+	uint64_t r1 = ((RowIdx *) a)->row, r2 = ((RowIdx *) b)->row;
+	return (r1 > r2) - (r1 < r2);
+}
+
+/*
+ Spreads the aggressors of h_patt over `spread` banks starting from bk.
+ Aggressors up to 2 rows apart share a victim (or hammer each other) and
+ form a run, whatever their position in d_lst: a run stays in one bank so
+ an n-sided victim keeps all its sides, and run k in row order lands on
+ bank bk ^ bank_at(k % spread). Consecutive runs differ in channel, then
+ bank group, so hammer_it() never pays the same bank group activation
+ delays between them (top bank bits on unlabeled layouts). spread <= 1
+ keeps everything in bk.
+ */
+void spread_banks(HammerPattern * h_patt, uint64_t bk, int spread)
+{
+	uint64_t banks = get_banks_cnt();
+
+	if (spread < 1)
+		spread = 1;
+	if ((uint64_t) spread > banks)
+		spread = banks;
+	if (spread == 1 || h_patt->len < 2) {
+		for (size_t i = 0; i < h_patt->len; i++)
+			h_patt->d_lst[i].bank = bk;
+		return;
+	}
+
+	RowIdx *rows = (RowIdx *) malloc(sizeof(RowIdx) * h_patt->len);
+	for (size_t i = 0; i < h_patt->len; i++) {
+		rows[i].row = h_patt->d_lst[i].row;
+		rows[i].idx = i;
+	}
+	qsort(rows, h_patt->len, sizeof(RowIdx), row_idx_cmp);
+	size_t run = 0;
+	for (size_t i = 0; i < h_patt->len; i++) {
+		if (i > 0 && rows[i].row - rows[i - 1].row > 2)
+			run++;
+		h_patt->d_lst[rows[i].idx].bank = bk ^ bank_at(run % spread);
+	}
+	free(rows);
+}
+
+// banks hammered by h_patt, scans cover all of them
+uint64_t patt_banks(HammerPattern * h_patt)
+{
+	uint64_t banks = 0;
+	for (size_t i = 0; i < h_patt->len; i++)
+		banks |= BIT_SET(h_patt->d_lst[i].bank);
+	return banks;
+}
+
+// fill, hammer, scan and restore a single pattern, banks are taken as they are
+uint64_t hammer_pattern(HammerSuite * suite, HammerPattern * h_patt)
+{
+	SessionConfig *cfg = suite->cfg;
+
+	h_patt->rounds = budget_rounds(suite, h_patt, h_patt->rounds);
+#ifdef FLIPTABLE
+	print_start_attack(h_patt);
+#endif
+	for (size_t idx = 0; idx < h_patt->len; idx++)
+		fill_row(suite, &h_patt->d_lst[idx], cfg->d_cfg, 0);
+
+	uint64_t time = hammer_segmented(suite, h_patt);
+
+	scan_rows(suite, h_patt, 0);
+	for (size_t idx = 0; idx < h_patt->len; idx++)
+		fill_row(suite, &h_patt->d_lst[idx], cfg->d_cfg, 1);
+#ifdef FLIPTABLE
+	print_end_attack();
+#endif
+	return time;
+}
+
 void __test_fill_random(char *addr, size_t size)
 {
 	int fd;
@@ -273,8 +517,17 @@ void fill_stripe(DRAMAddr d_addr, uint8_t val, ADDRMapper * mapper)
 
 }
 
+void mark_row_dirty(HammerSuite * suite, DRAMAddr * d_addr)
+{
+	if (suite->row_dirty == NULL)
+		return;
+	suite->row_dirty[(d_addr->row - suite->mapper->base_row) *
+			 get_banks_cnt() + d_addr->bank] = 1;
+}
+
 void fill_row(HammerSuite *suite, DRAMAddr *d_addr, HammerData data_patt, int reverse)
 {
+	mark_row_dirty(suite, d_addr);
 	if (p->vpat != (void *)NULL && p->tpat != (void *)NULL) {
 		uint8_t pat = reverse ? *p->vpat : *p->tpat;
 		fill_stripe(*d_addr, pat, suite->mapper);
@@ -309,6 +562,15 @@ void cl_rand_fill(DRAM_pte * pte)
 	memcpy(pte->v_addr, rand_data, CL_SIZE);
 }
 
+void fill_random(DRAMAddr d_addr, ADDRMapper * mapper)
+{
+	for (size_t col = 0; col < ROW_SIZE; col += (1 << 6)) {
+		d_addr.col = col;
+		DRAM_pte d_pte = get_dram_pte(mapper, &d_addr);
+		cl_rand_fill(&d_pte);
+	}
+}
+
 uint64_t cl_rand_comp(DRAM_pte * pte)
 {
 	char *rand_data = cl_rand_gen(&pte->d_addr);
@@ -339,6 +601,8 @@ void init_random(HammerSuite * suite)
 	ADDRMapper *mapper = suite->mapper;
 	DRAMAddr d_tmp;
 	for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
+		if (!(suite->banks & BIT_SET(bk)))
+			continue;
 		d_tmp.bank = bk;
 		for (size_t row = 0; row < suite->cfg->h_rows; row++) {
 			d_tmp.row = suite->mapper->base_row + row;
@@ -356,6 +620,8 @@ void init_stripe(HammerSuite * suite, uint8_t val)
 	ADDRMapper *mapper = suite->mapper;
 	DRAMAddr d_tmp;
 	for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
+		if (!(suite->banks & BIT_SET(bk)))
+			continue;
 		d_tmp.bank = bk;
 		for (size_t row = 0; row < suite->cfg->h_rows; row++) {
 			d_tmp.row = suite->mapper->base_row + row;
@@ -368,8 +634,40 @@ void init_stripe(HammerSuite * suite, uint8_t val)
 	}
 }
 
+// stripe value the chunk is initialized with, -1 for random data
+int chunk_stripe_val(HammerSuite * suite)
+{
+	if (p->vpat != (void *)NULL && p->tpat != (void *)NULL)
+		return (uint8_t) * p->vpat;
+
+	switch (suite->cfg->d_cfg) {
+	case ONE_TO_ZERO:
+		return 0xff;
+	case ZERO_TO_ONE:
+		return 0x00;
+	default:
+		return -1;
+	}
+}
+
+void init_row(HammerSuite * suite, DRAMAddr d_addr)
+{
+	int val = chunk_stripe_val(suite);
+	if (val == -1)
+		fill_random(d_addr, suite->mapper);
+	else
+		fill_stripe(d_addr, (uint8_t) val, suite->mapper);
+}
+
 void init_chunk(HammerSuite * suite)
 {
+	if (out_fd != NULL && (int)suite->cfg->d_cfg != g_out_d_cfg) {
+		g_out_d_cfg = suite->cfg->d_cfg;
+		fprintf(out_fd, "# { d_cfg: %s }\n", data_str[g_out_d_cfg]);
+	}
+	if (suite->row_dirty != NULL) {
+		memset(suite->row_dirty, 0x00, get_banks_cnt() * suite->cfg->h_rows);
+	}
 
 	if (p->vpat != (void *)NULL && p->tpat != (void *)NULL) {
 		init_stripe(suite, (uint8_t) * p->vpat);
@@ -395,43 +693,26 @@ void init_chunk(HammerSuite * suite)
 	}
 }
 
-void scan_random(HammerSuite * suite, HammerPattern * h_patt, size_t adj_rows)
+// rows of the chunk within adj_rows of an aggressor, every row if adj_rows is 0
+void scan_range(HammerSuite * suite, HammerPattern * h_patt, size_t adj_rows,
+		size_t * lo, size_t * hi)
 {
-	ADDRMapper *mapper = suite->mapper;
-	SessionConfig *cfg = suite->cfg;
-
-	DRAMAddr d_tmp;
-	FlipVal flip;
+	size_t base_row = suite->mapper->base_row;
+	size_t r_min = SIZE_MAX, r_max = 0;
 
-	d_tmp.bank = h_patt->d_lst[0].bank;
-
-	for (size_t row = 0; row < cfg->h_rows; row++) {
-		d_tmp.row = suite->mapper->base_row + row;
-		for (size_t col = 0; col < ROW_SIZE; col += (1 << 6)) {
-			d_tmp.col = col;
-			DRAM_pte pte = get_dram_pte(mapper, &d_tmp);
-			clflush(pte.v_addr);
-			cpuid();
-			uint64_t res = cl_rand_comp(&pte);
-			if (res) {
-				char *rand_data = cl_rand_gen(&pte.d_addr);
-				for (int off = 0; off < CL_SIZE; off++) {
-					if (!((res >> off) & 1))
-						continue;
-					d_tmp.col += off;
-
-					flip.d_vict = d_tmp;
-					flip.f_og = (uint8_t) rand_data[off];
-					flip.f_new = *(uint8_t *) (pte.v_addr + off);
-					flip.h_patt = h_patt;
-					assert(flip.f_og != flip.f_new);
-					export_flip(&flip);
+	*lo = 0;
+	*hi = suite->cfg->h_rows;
+	if (adj_rows == 0)
+		return;
 
-				}
-				memcpy((char *)(pte.v_addr), rand_data, CL_SIZE);
-			}
-		}
+	for (size_t i = 0; i < h_patt->len; i++) {
+		r_min = h_patt->d_lst[i].row < r_min ? h_patt->d_lst[i].row : r_min;
+		r_max = h_patt->d_lst[i].row > r_max ? h_patt->d_lst[i].row : r_max;
 	}
+	r_min -= base_row;
+	r_max -= base_row;
+	*lo = r_min > adj_rows ? r_min - adj_rows : 0;
+	*hi = r_max + adj_rows + 1 < *hi ? r_max + adj_rows + 1 : *hi;
 }
 
 int find_flip(HammerSuite * suite, HammerPattern * h_patt, FlipVal *orig)
@@ -481,63 +762,412 @@ uint64_t cl_stripe_cmp(DRAM_pte * pte, uint8_t val)
 	return res;
 }
 
+/*
+ Compares a single cache line against t_val (-1 for the random pattern),
+ reports and repairs every flipped byte. Returns 1 if the line had flips.
+ */
+static int scan_line(HammerSuite * suite, HammerPattern * h_patt,
+		     DRAMAddr d_tmp, int t_val)
+{
+	FlipVal flip;
+	char *rand_data = NULL;
+	uint64_t res;
+
+	DRAM_pte pte = get_dram_pte(suite->mapper, &d_tmp);
+	clflush(pte.v_addr);
+	cpuid();
+	if (t_val == -1)
+		res = cl_rand_comp(&pte);
+	else
+		res = cl_stripe_cmp(&pte, (uint8_t) t_val);
+	if (!res)
+		return 0;
+
+	if (t_val == -1)
+		rand_data = cl_rand_gen(&pte.d_addr);
+	for (int off = 0; off < CL_SIZE; off++) {
+		if (!((res >> off) & 1))
+			continue;
+		flip.d_vict = d_tmp;
+		flip.d_vict.col = d_tmp.col + off;
+		flip.f_og = t_val == -1 ? (uint8_t) rand_data[off] : (uint8_t) t_val;
+		flip.f_new = *(uint8_t *) (pte.v_addr + off);
+		flip.h_patt = h_patt;
+		assert(flip.f_og != flip.f_new);
+		report_flip(suite, &flip);
+	}
+	if (t_val == -1)
+		memcpy((char *)(pte.v_addr), rand_data, CL_SIZE);
+	else
+		memset((char *)(pte.v_addr), t_val, CL_SIZE);
+	mark_row_dirty(suite, &d_tmp);
+	g_scan.hot[d_tmp.col / CL_SIZE]++;
+	return 1;
+}
+
+/*
+ Sentinels for --sample N: every N-th line of the row, shifted by one line
+ at every scan so that all lines get their turn, plus the HOT_LINES lines
+ that flipped the most so far. Returns the number of sentinels, 0 when
+ rows are scanned in full.
+ */
+static size_t pick_sentinels(uint8_t * sent)
+{
+	size_t cnt = 0;
+
+	if (p->sample <= 1)
+		return 0;
+	memset(sent, 0x00, ROW_CLS);
+	for (size_t l = g_scan.phase++ % p->sample; l < ROW_CLS; l += p->sample) {
+		sent[l] = 1;
+		cnt++;
+	}
+	for (int h = 0; h < HOT_LINES; h++) {
+		size_t best = ROW_CLS;
+		for (size_t l = 0; l < ROW_CLS; l++) {
+			if (sent[l] || g_scan.hot[l] == 0)
+				continue;
+			if (best == ROW_CLS || g_scan.hot[l] > g_scan.hot[best])
+				best = l;
+		}
+		if (best == ROW_CLS)
+			break;
+		sent[best] = 1;
+		cnt++;
+	}
+	g_scan.sent = cnt;
+	return cnt;
+}
+
+// rewrites the lines of the row that are not sentinels, without reading them
+static void reset_row(DRAMAddr d_tmp, int t_val, uint8_t * sent, ADDRMapper * mapper)
+{
+	for (size_t l = 0; l < ROW_CLS; l++) {
+		if (sent[l])
+			continue;
+		d_tmp.col = l * CL_SIZE;
+		DRAM_pte pte = get_dram_pte(mapper, &d_tmp);
+		if (t_val == -1)
+			memcpy((char *)(pte.v_addr), cl_rand_gen(&pte.d_addr), CL_SIZE);
+		else
+			memset((char *)(pte.v_addr), t_val, CL_SIZE);
+	}
+}
+
+/*
+ Scans the sentinels first (if any), the rest of the row only if one of
+ them flipped. A clean sample leaves the other lines unread: the row is
+ marked dirty so a flip there is wiped by the next refresh, or rewritten
+ right away where rows are not tracked, instead of being reported against
+ whichever later pattern escalates on it.
+ */
+static void scan_row(HammerSuite * suite, HammerPattern * h_patt, DRAMAddr d_tmp,
+		     int t_val, uint8_t * sent, size_t s_cnt)
+{
+	size_t found = 0;
+
+	g_scan.rows++;
+	if (sent != NULL) {
+		for (size_t l = 0; l < ROW_CLS; l++) {
+			if (!sent[l])
+				continue;
+			d_tmp.col = l * CL_SIZE;
+			found += scan_line(suite, h_patt, d_tmp, t_val);
+		}
+		g_scan.lines += s_cnt;
+		if (!found) {
+			if (suite->row_dirty != NULL)
+				mark_row_dirty(suite, &d_tmp);
+			else
+				reset_row(d_tmp, t_val, sent, suite->mapper);
+			return;
+		}
+		g_scan.escalated++;
+	}
+	for (size_t l = 0; l < ROW_CLS; l++) {
+		if (sent != NULL && sent[l])
+			continue;
+		d_tmp.col = l * CL_SIZE;
+		found += scan_line(suite, h_patt, d_tmp, t_val);
+	}
+	g_scan.lines += ROW_CLS - s_cnt;
+	if (sent == NULL)
+		return;
+
+	// chance that a row with this many flipped lines had none on a sentinel
+	double miss = 1.0;
+	for (size_t j = 0; j < found; j++)
+		miss *= (double)(ROW_CLS - s_cnt - j) / (ROW_CLS - j);
+	g_scan.miss_acc += miss;
+}
+
+/*
+ Miss probability of the sampled scan for a row holding flips, averaged
+ over the flip counts of the rows escalated so far. Escalated rows are
+ biased towards many flips, so this is a lower bound; with no escalation
+ yet it falls back to a single flipped line.
+ */
+double scan_miss_prob()
+{
+	if (p->sample <= 1)
+		return 0.0;
+	if (g_scan.escalated == 0)
+		return 1.0 - (double)g_scan.sent / ROW_CLS;
+	return g_scan.miss_acc / g_scan.escalated;
+}
+
+ScanStats *get_scan_stats()
+{
+	return &g_scan;
+}
+
+void export_scan_stats()
+{
+	if (p->sample <= 1)
+		return;
+	fprintf(stderr,
+		"[LOG] - Sampled scan: %ld/%ld rows escalated, %.1f lines/row, est. miss p %.4f\n",
+		g_scan.escalated, g_scan.rows,
+		g_scan.rows ? (double)g_scan.lines / g_scan.rows : 0.0, scan_miss_prob());
+	fprintf(out_fd, "# { sample: %d, rows: %ld, escalated: %ld, miss_p: %.4f }\n",
+		p->sample, g_scan.rows, g_scan.escalated, scan_miss_prob());
+	fflush(out_fd);
+}
+
+void scan_random(HammerSuite * suite, HammerPattern * h_patt, size_t adj_rows)
+{
+	DRAMAddr d_tmp;
+	uint8_t sent[ROW_CLS];
+	uint64_t banks = patt_banks(h_patt);
+
+	size_t s_cnt = pick_sentinels(sent);
+
+	size_t r_lo, r_hi;
+	scan_range(suite, h_patt, adj_rows, &r_lo, &r_hi);
+	for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
+		if (!(banks & BIT_SET(bk)))
+			continue;
+		d_tmp.bank = bk;
+		for (size_t row = r_lo; row < r_hi; row++) {
+			d_tmp.row = suite->mapper->base_row + row;
+			scan_row(suite, h_patt, d_tmp, -1, s_cnt ? sent : NULL, s_cnt);
+		}
+	}
+}
+
 void scan_stripe(HammerSuite * suite, HammerPattern * h_patt, size_t adj_rows,
 		 uint8_t val)
 {
-	ADDRMapper *mapper = suite->mapper;
-	SessionConfig *cfg = suite->cfg;
-
 	DRAMAddr d_tmp;
-	FlipVal flip;
+	uint8_t sent[ROW_CLS];
+	uint64_t banks = patt_banks(h_patt);
 
-	d_tmp.bank = h_patt->d_lst[0].bank;
 	uint8_t t_val = val;
+	size_t s_cnt = pick_sentinels(sent);
 
-	for (size_t row = 0; row < cfg->h_rows; row++) {
+	size_t r_lo, r_hi;
+	scan_range(suite, h_patt, adj_rows, &r_lo, &r_hi);
+	for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
+		if (!(banks & BIT_SET(bk)))
+			continue;
+		d_tmp.bank = bk;
+		for (size_t row = r_lo; row < r_hi; row++) {
+			d_tmp.row = suite->mapper->base_row + row;
+			t_val = val;
+			if (in_hPatt(&d_tmp, h_patt))
+				if (p->tpat != (void *)NULL && p->vpat != (void *)NULL)
+					t_val = (uint8_t) * p->tpat;
+				else
+					t_val ^= 0xff;
+			scan_row(suite, h_patt, d_tmp, t_val, s_cnt ? sent : NULL, s_cnt);
+		}
+	}
+}
+
+// Re-initializes only the rows written since the last refresh (aggressors
+// and rows repaired by the scans). Returns the number of rows written.
+size_t refresh_chunk(HammerSuite * suite)
+{
+	size_t cnt = 0;
+	DRAMAddr d_tmp = {.bank = 0,.row = 0,.col = 0 };
+
+	for (size_t row = 0; row < suite->cfg->h_rows; row++) {
 		d_tmp.row = suite->mapper->base_row + row;
-		t_val = val;
-		if (in_hPatt(&d_tmp, h_patt))
-			if (p->tpat != (void *)NULL && p->vpat != (void *)NULL)
-				t_val = (uint8_t) * p->tpat;
-			else
-				t_val ^= 0xff;
-
-		for (size_t col = 0; col < ROW_SIZE; col += (1 << 6)) {
-			d_tmp.col = col;
-			DRAM_pte pte = get_dram_pte(mapper, &d_tmp);
-			clflush(pte.v_addr);
-			cpuid();
-
-			uint64_t res = cl_stripe_cmp(&pte, t_val);
-			if (res) {
-				for (int off = 0; off < CL_SIZE; off++) {
-					if (!((res >> off) & 1))
-						continue;
-					d_tmp.col += off;
-
-					flip.d_vict = d_tmp;
-					flip.f_og = (uint8_t) t_val;
-					flip.f_new = *(uint8_t *) (pte.v_addr + off);
-					flip.h_patt = h_patt;
-					export_flip(&flip);
-					memset(pte.v_addr + off, t_val, 1);
-				}
-				memset((char *)(pte.v_addr), t_val, CL_SIZE);
+		for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
+			if (!(suite->banks & BIT_SET(bk)))
+				continue;
+			uint8_t *dirty = &suite->row_dirty[row * get_banks_cnt() + bk];
+			if (!*dirty)
+				continue;
+			d_tmp.bank = bk;
+			init_row(suite, d_tmp);
+			*dirty = 0;
+			cnt++;
+		}
+	}
+	return cnt;
+}
+
+// Reads back the whole chunk and rewrites every row that doesn't hold the
+// expected content. Returns the number of mismatching cache lines.
+size_t verify_chunk(HammerSuite * suite)
+{
+	size_t cnt = 0;
+	int val = chunk_stripe_val(suite);
+	DRAMAddr d_tmp = {.bank = 0,.row = 0,.col = 0 };
+
+	for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
+		if (!(suite->banks & BIT_SET(bk)))
+			continue;
+		d_tmp.bank = bk;
+		for (size_t row = 0; row < suite->cfg->h_rows; row++) {
+			d_tmp.row = suite->mapper->base_row + row;
+			size_t bad = 0;
+			for (size_t col = 0; col < ROW_SIZE; col += (1 << 6)) {
+				d_tmp.col = col;
+				DRAM_pte pte = get_dram_pte(suite->mapper, &d_tmp);
+				clflush(pte.v_addr);
+				cpuid();
+				uint64_t res = (val == -1) ? cl_rand_comp(&pte) :
+				    cl_stripe_cmp(&pte, (uint8_t) val);
+				if (res)
+					bad++;
 			}
+			d_tmp.col = 0;
+			if (bad)
+				init_row(suite, d_tmp);
+			cnt += bad;
+			if (suite->row_dirty != NULL)
+				suite->row_dirty[row * get_banks_cnt() + bk] = 0;
 		}
 	}
+	return cnt;
 }
 
-// TODO adj_rows should tell how many rows to scan out of the bank. Not currently used
-void scan_rows(HammerSuite * suite, HammerPattern * h_patt, size_t adj_rows)
+// true if any row next to an aggressor already lost its content
+static bool victims_flipped(HammerSuite * suite, HammerPattern * h_patt)
 {
-	if (p->vpat != (void *)NULL && p->tpat != (void *)NULL) {
-		scan_stripe(suite, h_patt, adj_rows, (uint8_t) * p->vpat);
-		return;
+	int val = chunk_stripe_val(suite);
+	size_t base_row = suite->mapper->base_row;
+	DRAMAddr d_tmp;
+
+	for (size_t i = 0; i < h_patt->len; i++) {
+		for (int side = -1; side <= 1; side += 2) {
+			d_tmp = h_patt->d_lst[i];
+			d_tmp.row += side;
+			if (d_tmp.row < base_row || d_tmp.row >= base_row + suite->cfg->h_rows)
+				continue;
+			if (in_hPatt(&d_tmp, h_patt))
+				continue;
+			for (size_t col = 0; col < ROW_SIZE; col += CL_SIZE) {
+				d_tmp.col = col;
+				clflush(get_dram_pte(suite->mapper, &d_tmp).v_addr);
+			}
+			mfence();
+			for (size_t col = 0; col < ROW_SIZE; col += CL_SIZE) {
+				d_tmp.col = col;
+				DRAM_pte pte = get_dram_pte(suite->mapper, &d_tmp);
+				uint64_t res = (val == -1) ? cl_rand_comp(&pte) :
+				    cl_stripe_cmp(&pte, (uint8_t) val);
+				if (res)
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+// moving average, the first measurement replaces the probe
+static void update_acc_cost(size_t accs, uint64_t ns)
+{
+	double acc_ns = (double)ns / accs;
+	g_last_acc_ns = acc_ns;
+	g_acc_ns = g_acc_ns == 0.0 ? acc_ns : (7 * g_acc_ns + acc_ns) / 8;
+}
+
+/*
+ Rounds that keep h_patt hammering for the --budget time, from the
+ measured cost of an aggressor access. With no measurement yet, a short
+ probe of h_patt itself is timed first. Returns dflt without a budget.
+ */
+size_t budget_rounds(HammerSuite * suite, HammerPattern * h_patt, size_t dflt)
+{
+	if (p->budget_ns == 0 || h_patt->len == 0)
+		return dflt;
+
+	if (g_acc_ns == 0.0) {
+		HammerPattern probe = *h_patt;
+		probe.rounds = PROBE_ROUNDS;
+		hammer_it(&probe, suite->mem);
+		update_acc_cost(probe.len * probe.rounds, g_window_ns);
+	}
+	size_t rounds = p->budget_ns / (g_acc_ns * h_patt->len);
+	return rounds > 0 ? rounds : 1;
+}
+
+/*
+ With --segments N the rounds are split in N segments and the rows next to
+ the aggressors are checked after each of them: hammering stops at the
+ first flip. Reading the victims refreshes them, so a segment only counts
+ the activations since the previous check: the rounds of the flipping
+ segment are written after the attack as "# { min_rounds: N, ... }",
+ total_rounds being all the rounds hammered on the pattern.
+ */
+uint64_t hammer_segmented(HammerSuite * suite, HammerPattern * h_patt)
+{
+	size_t done = h_patt->rounds;
+	uint64_t time = 0;
+
+	// the victims are still scanned, they just cannot have flipped
+	size_t bad = p->conflicts ? check_conflicts(h_patt, suite->mem) : 0;
+	if (bad && p->conflicts == CONF_SKIP) {
+		get_conflict_stats()->skipped++;
+		return 0;
 	}
+	// only the hammer windows count, not the scans between segments
+	uint64_t hammer_ns = 0;
+	metrics_pattern(h_patt);
+	flipstream_pattern();
+
+	if (p->segments <= 1) {
+		time = hammer_it(h_patt, suite->mem);
+		hammer_ns = g_window_ns;
+	} else {
+		HammerPattern seg = *h_patt;
+		size_t step = (h_patt->rounds + p->segments - 1) / p->segments;
+
+		for (done = 0; done < h_patt->rounds;) {
+			seg.rounds = h_patt->rounds - done < step ? h_patt->rounds - done : step;
+			time += hammer_it(&seg, suite->mem);
+			hammer_ns += g_window_ns;
+			done += seg.rounds;
+			if (victims_flipped(suite, h_patt)) {
+				g_min_rounds = seg.rounds;
+				g_total_rounds = done;
+				break;
+			}
+		}
+	}
+	if (done > 0 && h_patt->len > 0)
+		update_acc_cost(h_patt->len * done, hammer_ns);
+	return time;
+}
 
+// adj_rows limits the scan to the rows around the aggressors (default: --radius)
+void scan_rows(HammerSuite * suite, HammerPattern * h_patt, size_t adj_rows)
+{
+	if (adj_rows == 0)
+		adj_rows = p->radius;
+
+	uint64_t t0 = realtime_now();
+	size_t lines = g_scan.lines;
+	PerfSample ps;
+	if (p->perf)
+		perf_begin(&ps);
 	SessionConfig *cfg = suite->cfg;
-	switch (cfg->d_cfg) {
+	if (p->vpat != (void *)NULL && p->tpat != (void *)NULL) {
+		scan_stripe(suite, h_patt, adj_rows, (uint8_t) * p->vpat);
+	} else switch (cfg->d_cfg) {
 	case RANDOM:
 		// rows are already filled for random data patt
 		scan_random(suite, h_patt, adj_rows);
@@ -554,6 +1184,9 @@ void scan_rows(HammerSuite * suite, HammerPattern * h_patt, size_t adj_rows)
 		exit(1);
 		break;
 	}
+	if (p->perf)
+		perf_end(&ps, PERF_SCAN, 0, 0);
+	metrics_scan((g_scan.lines - lines) * CL_SIZE, realtime_now() - t0);
 }
 
 int free_triple_sided_test(HammerSuite * suite)
@@ -587,9 +1220,7 @@ int free_triple_sided_test(HammerSuite * suite)
 			h_patt.d_lst[2].bank = 0;
 			fprintf(stderr, "[HAMMER] - %s: ", hPatt_2_str(&h_patt, ROW_FIELD));
 			for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
-				h_patt.d_lst[0].bank = bk;
-				h_patt.d_lst[1].bank = bk;
-				h_patt.d_lst[2].bank = bk;
+				spread_banks(&h_patt, bk, p->spread);
 				// fill all the aggressor rows
 				for (int idx = 0; idx < 3; idx++) {
 					fill_row(suite, &h_patt.d_lst[idx], cfg->d_cfg, 0);
@@ -645,9 +1276,7 @@ int assisted_double_sided_test(HammerSuite * suite)
 		h_patt.d_lst[2].bank = 0;
 		fprintf(stderr, "[HAMMER] - %s: ", hPatt_2_str(&h_patt, ROW_FIELD));
 		for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
-			h_patt.d_lst[0].bank = bk;
-			h_patt.d_lst[1].bank = bk;
-			h_patt.d_lst[2].bank = bk;
+			spread_banks(&h_patt, bk, p->spread);
 			// fill all the aggressor rows
 			for (int idx = 0; idx < 3; idx++) {
 				fill_row(suite, &h_patt.d_lst[idx], cfg->d_cfg, 0);
@@ -703,9 +1332,8 @@ int n_sided_test(HammerSuite * suite)
 		fprintf(stderr, "[HAMMER] - %s: ", hPatt_2_str(&h_patt, ROW_FIELD));
 		for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
 
-			for (int s = 0; s < cfg->aggr_n; s++) {
-				h_patt.d_lst[s].bank = bk;
-			}
+			spread_banks(&h_patt, bk, p->spread);
+			h_patt.rounds = budget_rounds(suite, &h_patt, cfg->h_rounds);
 #ifdef FLIPTABLE
 				print_start_attack(&h_patt);
 #endif
@@ -714,7 +1342,7 @@ int n_sided_test(HammerSuite * suite)
 				fill_row(suite, &h_patt.d_lst[idx], cfg->d_cfg, 0);
 			}
 
-			uint64_t time = hammer_it(&h_patt, mem);
+			uint64_t time = hammer_segmented(suite, &h_patt);
 			fprintf(stderr, "%ld ", time);
 
 			scan_rows(suite, &h_patt, 0);
@@ -730,62 +1358,197 @@ int n_sided_test(HammerSuite * suite)
 	free(h_patt.d_lst);
 }
 
-void fuzz(HammerSuite *suite, int d, int v)
+// fills h_patt->d_lst on bank 0
+static void build_shape(HammerSuite *suite, HammerPattern *h_patt, int d, int v, int offset)
 {
 	int i;
-	HammerPattern h_patt;
-	SessionConfig *cfg = suite->cfg;
-	h_patt.rounds = cfg->h_rounds;
-	h_patt.len = cfg->aggr_n;
-
-	h_patt.d_lst = (DRAMAddr *) malloc(sizeof(DRAMAddr) * h_patt.len);
-	memset(h_patt.d_lst, 0x00, sizeof(DRAMAddr) * h_patt.len);
-
-	init_chunk(suite);
-	int offset = random_int(1, 32);
+	memset(h_patt->d_lst, 0x00, sizeof(DRAMAddr) * h_patt->len);
+
+	h_patt->d_lst[0] = suite->d_base;
+	h_patt->d_lst[0].row = suite->d_base.row + offset;
+
+	h_patt->d_lst[1] = suite->d_base;
+	h_patt->d_lst[1].row = h_patt->d_lst[0].row + v + 1;
+	for (i = 2; i < h_patt->len-1; i+=2) {
+		h_patt->d_lst[i] = suite->d_base;
+		h_patt->d_lst[i].row = h_patt->d_lst[i-1].row + d + 1;
+		h_patt->d_lst[i+1] = suite->d_base;
+		h_patt->d_lst[i+1].row = h_patt->d_lst[i].row + v + 1;
+	}
+	if (h_patt->len % 2) {
+		h_patt->d_lst[h_patt->len-1] = suite->d_base;
+		h_patt->d_lst[h_patt->len-1].row = h_patt->d_lst[h_patt->len-2].row + d + 1;
+	}
 
-	h_patt.d_lst[0] = suite->d_base;
-	h_patt.d_lst[0].row = suite->d_base.row + offset;
+	// every bank gets the same pattern, only the shape matters
+	spread_banks(h_patt, 0, p->spread);
+}
 
-	h_patt.d_lst[1] = suite->d_base;
-	h_patt.d_lst[1].row = h_patt.d_lst[0].row + v + 1;
-	for (i = 2; i < h_patt.len-1; i+=2) {
-		h_patt.d_lst[i] = suite->d_base;
-		h_patt.d_lst[i].row = h_patt.d_lst[i-1].row + d + 1;
-		h_patt.d_lst[i+1] = suite->d_base;
-		h_patt.d_lst[i+1].row = h_patt.d_lst[i].row + v + 1;
+/*
+ Distinct shapes the fuzzer can draw, measured by building all of them:
+ the offset is not part of a shape and some (len, d, v) fall together.
+ */
+static size_t fuzz_space(HammerSuite *suite)
+{
+	HammerPattern h_patt;
+	PattSet shapes;
+
+	h_patt.d_lst = (DRAMAddr *) malloc(sizeof(DRAMAddr) * FUZZ_LEN_MAX);
+	init_patt_set(&shapes, PSET_CAP_std);
+	for (int len = FUZZ_LEN_MIN; len < FUZZ_LEN_MAX; len++) {
+		h_patt.len = len;
+		for (int d = 0; d < FUZZ_D_MAX; d++) {
+			for (int v = 1; v < FUZZ_V_MAX; v++) {
+				build_shape(suite, &h_patt, d, v, 1);
+				patt_set_add(&shapes, canon_patt(&h_patt, get_banks_mask()));
+			}
+		}
 	}
-	if (h_patt.len % 2) {
-		h_patt.d_lst[h_patt.len-1] = suite->d_base;
-		h_patt.d_lst[h_patt.len-1].row = h_patt.d_lst[h_patt.len-2].row + d + 1;
+	size_t space = shapes.len;
+	free_patt_set(&shapes);
+	free(h_patt.d_lst);
+	return space;
+}
+
+/*
+ Fills h_patt->d_lst on bank 0, returns 0 if the shape was tested enough
+ already. Once every shape of the space has used its budget the budget is
+ raised on the spot; PSET_MAX_SKIPS duplicates in a row raise it as well
+ in case the space is not known.
+ */
+static int fuzz_shape(HammerSuite *suite, HammerPattern *h_patt, int d, int v, int offset,
+		      PattSet *seen)
+{
+	build_shape(suite, h_patt, d, v, offset);
+	uint64_t key = canon_patt(h_patt, get_banks_mask());
+	if (seen->budget && patt_set_get(seen, key) >= seen->budget) {
+		seen->skipped++;
+		bool covered = seen->space && seen->full >= seen->space;
+		if (!covered && ++seen->skip_run < PSET_MAX_SKIPS)
+			return 0;
+		patt_set_raise(seen);
+		fprintf(stderr, "[LOG] - %ld patterns tested, repeat budget raised to %ld\n",
+			seen->len, seen->budget);
+		if (!covered)
+			return 0;
 	}
+	seen->skip_run = 0;
+	seen->tested++;
+	patt_set_add(seen, key);
+	return 1;
+}
 
-	fprintf(stderr, "[HAMMER] - %s: ", hPatt_2_str(&h_patt, ROW_FIELD));
-	for (int bk = 0; bk < get_banks_cnt(); bk++)
+/*
+ Hammers the shape on every bank, job holds it spread and translated if not
+ NULL. With --halving N the shape starts on N banks from a random point of
+ the interleaving order and the set doubles only while the last stage
+ flipped a bit or had a window HALVING_ANOM times slower than usual, so
+ dead shapes cost N windows instead of one per bank. Only the hammer
+ windows are compared (g_window_ns): evset builds, conflict checks and
+ segment scans are one-time or per-pattern costs, not anomalies.
+ */
+static void fuzz_banks(HammerSuite *suite, HammerPattern *h_patt, PattJob *job)
+{
+	SessionConfig *cfg = suite->cfg;
+	size_t banks = get_banks_cnt();
+	size_t stage = p->halving && (size_t) p->halving < banks ? p->halving : banks;
+	size_t start = p->halving ? random_int(0, banks) : 0;
+	bool hit = false;
+
+	fprintf(stderr, "[HAMMER] - %s: ", hPatt_2_str(h_patt, ROW_FIELD));
+	size_t i;
+	for (i = 0; i < banks; i++)
 	{
-		for (int idx = 0; idx < h_patt.len; idx++) {
-			h_patt.d_lst[idx].bank = bk;
+		if (i == stage) {
+			if (!hit)
+				break;
+			hit = false;
+			stage = 2 * stage < banks ? 2 * stage : banks;
 		}
+		size_t bk = p->halving ? bank_at((start + i) % banks) : i;
+		if (job != NULL) {
+			h_patt->d_lst = job->d_lst + bk * h_patt->len;
+			g_ready.d_lst = h_patt->d_lst;
+			g_ready.v_lst = job->v_lst + bk * h_patt->len;
+		} else {
+			spread_banks(h_patt, bk, p->spread);
+		}
+		h_patt->rounds = budget_rounds(suite, h_patt, cfg->h_rounds);
 #ifdef FLIPTABLE
-		print_start_attack(&h_patt);
+		print_start_attack(h_patt);
 #endif
-		for (int idx = 0; idx < h_patt.len; idx++)
-			fill_row(suite, &h_patt.d_lst[idx], suite->cfg->d_cfg, 0);
+		for (int idx = 0; idx < h_patt->len; idx++)
+			fill_row(suite, &h_patt->d_lst[idx], suite->cfg->d_cfg, 0);
 
-		uint64_t time = hammer_it(&h_patt, suite->mem);
+		size_t flips = g_flips;
+		double base = g_acc_ns;
+		g_last_acc_ns = 0.0;
+		uint64_t time = hammer_segmented(suite, h_patt);
 		fprintf(stderr, "%lu ",time);
 
-		scan_rows(suite, &h_patt, 0);
-		for (int idx = 0; idx<h_patt.len; idx++) {
-			fill_row(suite, &h_patt.d_lst[idx], suite->cfg->d_cfg, 1);
+		scan_rows(suite, h_patt, 0);
+		for (int idx = 0; idx<h_patt->len; idx++) {
+			fill_row(suite, &h_patt->d_lst[idx], suite->cfg->d_cfg, 1);
 		}
+		if (g_flips != flips ||
+		    (base > 0.0 && g_last_acc_ns > 0.0 && g_last_acc_ns > HALVING_ANOM * base))
+			hit = true;
 
 #ifdef FLIPTABLE
 		print_end_attack();
 #endif
 	}
+	g_halving.patterns++;
+	g_halving.windows += i;
+	g_halving.saved += banks - i;
+	if (i == banks)
+		g_halving.full++;
+	g_ready.d_lst = NULL;
+	g_ready.v_lst = NULL;
 	fprintf(stdout, "\n");
+}
+
+int fuzz(HammerSuite *suite, int d, int v, PattSet *seen)
+{
+	HammerPattern h_patt;
+	SessionConfig *cfg = suite->cfg;
+	h_patt.rounds = cfg->h_rounds;
+	h_patt.len = cfg->aggr_n;
+
+	h_patt.d_lst = (DRAMAddr *) malloc(sizeof(DRAMAddr) * h_patt.len);
+
+	int offset = random_int(1, 32);
+	if (!fuzz_shape(suite, &h_patt, d, v, offset, seen)) {
+		free(h_patt.d_lst);
+		return 0;
+	}
+	fuzz_banks(suite, &h_patt, NULL);
 	free(h_patt.d_lst);
+	return 1;
+}
+
+// fuzz() on the producer thread of --pipeline, with its own random state
+typedef struct {
+	HammerSuite *suite;
+	PattSet *seen;
+	unsigned int seed;
+} FuzzGen;
+
+static int random_int_r(unsigned int *seed, int min, int max)
+{
+	return min + rand_r(seed) % (max - min);
+}
+
+static int fuzz_gen(void *ctx, HammerPattern *h_patt)
+{
+	FuzzGen *g = (FuzzGen *) ctx;
+
+	h_patt->rounds = g->suite->cfg->h_rounds;
+	h_patt->len = random_int_r(&g->seed, FUZZ_LEN_MIN, FUZZ_LEN_MAX);
+	int d = random_int_r(&g->seed, 0, FUZZ_D_MAX);
+	int v = random_int_r(&g->seed, 1, FUZZ_V_MAX);
+	int offset = random_int_r(&g->seed, 1, 32);
+	return fuzz_shape(g->suite, h_patt, d, v, offset, g->seen);
 }
 
 void create_dir(const char* dir_name)
@@ -796,6 +1559,61 @@ void create_dir(const char* dir_name)
 	}
 }
 
+// every field not given is zeroed
+HammerSuite *new_suite(SessionConfig * cfg, MemoryBuffer * mem, DRAMAddr d_base)
+{
+	HammerSuite *suite = (HammerSuite *) calloc(1, sizeof(HammerSuite));
+	suite->mem = mem;
+	suite->cfg = cfg;
+	suite->d_base = d_base;
+	suite->banks = get_banks_mask();
+	return suite;
+}
+
+void open_out_file(char *out_name, SessionConfig * cfg)
+{
+	if (p->g_flags & F_NO_OVERWRITE) {
+		int cnt = 0;
+		char *tmp_name = (char *)malloc(500);
+		strncpy(tmp_name, out_name, strlen(out_name));
+		while (access(tmp_name, F_OK) != -1) {
+			cnt++;
+			sprintf(tmp_name, "%s.%02d", out_name, cnt);
+		}
+		strncpy(out_name, tmp_name, strlen(tmp_name));
+		free(tmp_name);
+	}
+	out_fd = fopen(out_name, "w+");
+	assert(out_fd != NULL);
+	export_placement();
+	export_session(cfg);
+}
+
+static void export_dedup_stats(PattSet * seen)
+{
+	size_t total = seen->tested + seen->skipped;
+	double rate = total ? (double)seen->skipped / total : 0.0;
+
+	fprintf(stderr, "[LOG] - Patterns: %ld tested, %ld/%ld unique, %ld duplicates skipped (%.1f%%)\n",
+		seen->tested, seen->len, seen->space, seen->skipped, 100.0 * rate);
+	fprintf(out_fd, "# { tested: %ld, unique: %ld, skipped: %ld, dup_rate: %.4f }\n",
+		seen->tested, seen->len, seen->skipped, rate);
+	fflush(out_fd);
+}
+
+static void export_halving_stats()
+{
+	if (!p->halving)
+		return;
+	fprintf(stderr, "[LOG] - Halving: %ld patterns, %ld on every bank, %.1f banks/pattern, %ld windows saved\n",
+		g_halving.patterns, g_halving.full,
+		g_halving.patterns ? (double)g_halving.windows / g_halving.patterns : 0.0,
+		g_halving.saved);
+	fprintf(out_fd, "# { halving_patterns: %ld, full: %ld, windows: %ld, saved: %ld }\n",
+		g_halving.patterns, g_halving.full, g_halving.windows, g_halving.saved);
+	fflush(out_fd);
+}
+
 void fuzzing_session(SessionConfig * cfg, MemoryBuffer * mem)
 {
 	int d, v, aggrs;
@@ -821,32 +1639,61 @@ void fuzzing_session(SessionConfig * cfg, MemoryBuffer * mem)
 	strcat(out_name, ".");
 	strcat(out_name, REFRESH_VAL);
 	strcat(out_name, ".csv");
-	if (p->g_flags & F_NO_OVERWRITE) {
-		int cnt = 0;
-		char *tmp_name = (char *)malloc(500);
-		strncpy(tmp_name, out_name, strlen(out_name));
-		while (access(tmp_name, F_OK) != -1) {
-			cnt++;
-			sprintf(tmp_name, "%s.%02d", out_name, cnt);
-		}
-		strncpy(out_name, tmp_name, strlen(tmp_name));
-		free(tmp_name);
-	}
-	out_fd = fopen(out_name, "w+");
-	assert(out_fd != NULL);
+	open_out_file(out_name, cfg);
 
-	HammerSuite *suite = (HammerSuite *) malloc(sizeof(HammerSuite));
-	suite->mem = mem;
-	suite->cfg = cfg;
-	suite->d_base = d_base;
+	HammerSuite *suite = new_suite(cfg, mem, d_base);
 	suite->mapper = (ADDRMapper *) malloc(sizeof(ADDRMapper));
 	init_addr_mapper(suite->mapper, mem, &suite->d_base, cfg->h_rows);
+	suite->row_dirty = (uint8_t *) calloc(get_banks_cnt() * cfg->h_rows, 1);
+	init_chunk(suite);
 
-	while(1) {
-		cfg->aggr_n = random_int(2, 32);
-		d = random_int(0, 16);
-		v = random_int(1, 4);
-		fuzz(suite, d, v);
+	PattSet seen;
+	init_patt_set(&seen, PSET_CAP_std);
+	seen.budget = p->repeat;
+	seen.space = fuzz_space(suite);
+
+	// the producer owns seen from here on
+	PattQueue queue;
+	FuzzGen gen = { suite, &seen, (unsigned int)CL_SEED };
+	if (p->pipeline)
+		init_patt_queue(&queue, p->pipeline, fuzz_gen, &gen, mem);
+
+	for (size_t iter = 1;; iter++) {
+		// only rows touched by the previous pattern are rewritten, the
+		// whole chunk is checked every verify_every iterations
+		if (p->verify_every > 0 && iter % p->verify_every == 0) {
+			size_t bad = verify_chunk(suite);
+			if (bad)
+				fprintf(stderr, "[LOG] - Verify: %ld lines re-initialized\n", bad);
+			export_scan_stats();
+			export_conflict_stats();
+			export_rt_stats();
+			export_perf_stats();
+			if (p->pipeline) {
+				pthread_mutex_lock(&queue.lock);
+				export_dedup_stats(&seen);
+				fprintf(stderr, "[LOG] - Pattern queue: %ld produced, hammer thread waited %ld times\n",
+					queue.tail, queue.waits);
+				pthread_mutex_unlock(&queue.lock);
+			} else {
+				export_dedup_stats(&seen);
+			}
+			export_halving_stats();
+		} else {
+			refresh_chunk(suite);
+		}
+		if (p->pipeline) {
+			PattJob *job = patt_queue_pop(&queue);
+			HammerPattern h_patt = job->patt;
+			fuzz_banks(suite, &h_patt, job);
+			patt_queue_done(&queue);
+			continue;
+		}
+		do {
+			cfg->aggr_n = random_int(FUZZ_LEN_MIN, FUZZ_LEN_MAX);
+			d = random_int(0, FUZZ_D_MAX);
+			v = random_int(1, FUZZ_V_MAX);
+		} while (!fuzz(suite, d, v, &seen));
 	}
 }
 
@@ -883,28 +1730,14 @@ void hammer_session(SessionConfig * cfg, MemoryBuffer * memory)
 	strcat(out_name, ".");
 	strcat(out_name, REFRESH_VAL);
 	strcat(out_name, ".csv");
-	if (p->g_flags & F_NO_OVERWRITE) {
-		int cnt = 0;
-		char *tmp_name = (char *)malloc(500);
-		strncpy(tmp_name, out_name, strlen(out_name));
-		while (access(tmp_name, F_OK) != -1) {
-			cnt++;
-			sprintf(tmp_name, "%s.%02d", out_name, cnt);
-		}
-		strncpy(out_name, tmp_name, strlen(tmp_name));
-		free(tmp_name);
-	}
-	out_fd = fopen(out_name, "w+");
+	open_out_file(out_name, cfg);
 
 	fprintf(stderr,
 		"[LOG] - Hammer session! access pattern: %s\t data pattern: %s\n",
 		config_str[cfg->h_cfg], data_str[cfg->d_cfg]);
 	fprintf(stderr, "[LOG] - File: %s\n", out_name);
 
-	HammerSuite *suite = (HammerSuite *) malloc(sizeof(HammerSuite));
-	suite->cfg = cfg;
-	suite->mem = &mem;
-	suite->d_base = d_base;
+	HammerSuite *suite = new_suite(cfg, &mem, d_base);
 	suite->mapper = (ADDRMapper *) malloc(sizeof(ADDRMapper));
 	init_addr_mapper(suite->mapper, &mem, &suite->d_base, cfg->h_rows);
 
@@ -943,3 +1776,63 @@ void hammer_session(SessionConfig * cfg, MemoryBuffer * memory)
 	tear_down_addr_mapper(suite->mapper);
 	free(suite);
 }
+
+void batch_session(SessionConfig * cfg, MemoryBuffer * mem)
+{
+	PatternSpec spec;
+
+	DRAMAddr d_base = phys_2_dram(virt_2_phys(mem->buffer, mem));
+	d_base.row += cfg->base_off;
+	d_base.col = 0;
+
+	HammerSuite *suite = new_suite(cfg, mem, d_base);
+
+	if (load_pattern_spec(p->patt_file, &spec, suite)) {
+		free(suite);
+		exit(1);
+	}
+
+	create_dir(DATA_DIR);
+	char *out_name = (char *)malloc(500);
+	char rows_str[10];
+	strcpy(out_name, DATA_DIR);
+	strcat(out_name, p->g_out_prefix);
+	strcat(out_name, ".");
+	strcat(out_name, "batch");
+	strcat(out_name, ".");
+	sprintf(rows_str, "%08ld", d_base.row);
+	strcat(out_name, rows_str);
+	strcat(out_name, ".");
+	sprintf(rows_str, "%ld", spec.len);
+	strcat(out_name, rows_str);
+	strcat(out_name, ".");
+	strcat(out_name, REFRESH_VAL);
+	strcat(out_name, ".csv");
+	open_out_file(out_name, cfg);
+
+	fprintf(stderr, "[LOG] - Batch session! %ld patterns from %s\n", spec.len,
+		p->patt_file);
+	fprintf(stderr, "[LOG] - File: %s\n", out_name);
+
+	// shared setup, paid once for the whole spec
+	suite->mapper = (ADDRMapper *) malloc(sizeof(ADDRMapper));
+	init_addr_mapper(suite->mapper, mem, &suite->d_base, cfg->h_rows);
+	init_chunk(suite);
+
+	for (size_t i = 0; i < spec.len; i++) {
+		SpecEntry *entry = &spec.lst[i];
+		fprintf(stderr, "[HAMMER] - %s: ", hPatt_2_str(&entry->h_patt, ROW_FIELD));
+		uint64_t time = run_spec_entry(suite, entry);
+		fprintf(stderr, "%ld\n", time);
+	}
+	export_scan_stats();
+	export_conflict_stats();
+	export_rt_stats();
+	export_perf_stats();
+
+	fclose(out_fd);
+	free_pattern_spec(&spec);
+	tear_down_addr_mapper(suite->mapper);
+	free(suite);
+	free(out_name);
+}
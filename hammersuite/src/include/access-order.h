@@ -0,0 +1,29 @@
+#pragma once
+
+#include "types.h"
+#include "dram-address.h"
+#include "hammer-suite.h"
+
+#define LAT_MAGIC	0x7472726c6174656eULL	// "trrlaten"
+#define LAT_BANKS	(1 << HASH_FN_CNT)
+#define LAT_REPS	256		// timed accesses per bank pair
+#define LAT_HIT		(~0U)		// same row back to back, not an activation
+#define ORDER_PASSES	4		// 2-opt passes after the greedy order
+#define BENCH_PATTS	16
+
+/*
+ Cost in cycles of activating a row of bank b right after a row of bank
+ a, measured once per DRAM layout and kept in DATA_DIR/lat.<layout>.bin so
+ that later runs on the same mapping skip the measurement.
+ */
+typedef struct {
+	uint64_t magic;
+	uint64_t layout;	// hash of the DRAMLayout it was measured with
+	uint64_t banks;
+	uint32_t lat[LAT_BANKS][LAT_BANKS];
+} LatMatrix;
+
+LatMatrix *get_lat_matrix(MemoryBuffer * mem);
+uint64_t order_cost(LatMatrix * m, HammerPattern * h_patt, size_t * order);
+uint64_t order_accesses(LatMatrix * m, HammerPattern * h_patt, size_t * order);
+void order_bench(SessionConfig * cfg, MemoryBuffer * mem);
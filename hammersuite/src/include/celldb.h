@@ -0,0 +1,82 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+#include "utils.h"
+
+#define CELLDB_MAGIC	0x74727263656c6c32ULL	// "trrcell2"
+#define CELLDB_SLOTS	(1ULL << 22)		// cells, power of two
+#define CELLDB_ROWS	(1ULL << 20)		// rows with cells, power of two
+#define CELLDB_PWORDS	(1ULL << 22)		// pattern log, 8B words
+
+#define CELL_PULLDN	BIT_SET(0)		// 1 -> 0 seen
+#define CELL_PULLUP	BIT_SET(1)		// 0 -> 1 seen
+#define CELL_ANY_BANK	(~0ULL)
+
+#define CELL_KEY(bank, row, col, bit) \
+	(BIT_SET(63) | ((uint64_t)(bank) << 48) | ((uint64_t)(row) << 16) | \
+	 ((uint64_t)(col) << 3) | (uint64_t)(bit))
+#define CELL_BANK(key)	(((key) >> 48) & 0x7fff)
+#define CELL_ROW(key)	(((key) >> 16) & 0xffffffff)
+#define CELL_COL(key)	(((key) >> 3) & 0x1fff)
+#define CELL_BIT(key)	((key) & 0x7)
+#define ROW_KEY(bank, row) \
+	(BIT_SET(63) | ((uint64_t)(bank) << 32) | (uint64_t)(row))
+
+/*
+ Persistent index of every vulnerable cell seen, shared by all the runs
+ pointed to the same file. The file is a header, an open addressing table
+ of CELLDB_SLOTS cells keyed by (bank, row, col, bit), a second table of
+ CELLDB_ROWS rows keyed by (bank, row) that heads the list of the cells
+ of each row, and an append only log of the patterns that flipped them:
+ one word with the number of aggressors followed by (bank << 32 | row)
+ for each of them.
+ Updates are atomic so concurrent runs (e.g. sweep shards) can share it.
+ */
+typedef struct {
+	uint64_t magic;
+	uint64_t slots;
+	uint64_t cells;		// used slots
+	uint64_t p_cap;		// pattern log size in words
+	uint64_t p_len;		// words used, 0 is never a valid offset
+	uint64_t rows;		// row table size
+	uint64_t banks;		// highest bank seen + 1
+	uint64_t unindexed;	// cells left out of a full row table
+} CellDBHeader;
+
+typedef struct {
+	uint64_t key;		// 0 = empty, see CELL_KEY()
+	uint32_t hits;
+	uint8_t dirs;		// CELL_PULLDN | CELL_PULLUP
+	uint8_t pad[3];
+	uint64_t first;		// unix time of the first/last flip
+	uint64_t last;
+	uint64_t p_first;	// offsets of the first/last pattern in the log
+	uint64_t p_last;
+	uint64_t patts;		// producing pattern changes, first included
+	uint64_t next;		// next cell of the row, slot index + 1, 0 ends
+} CellSlot;
+
+typedef struct {
+	uint64_t key;		// 0 = empty, see ROW_KEY()
+	uint64_t head;		// first cell of the row, slot index + 1
+} RowSlot;
+
+typedef struct {
+	CellDBHeader *hdr;
+	CellSlot *slots;
+	RowSlot *rows;
+	uint64_t *p_log;
+	size_t size;
+	int fd;
+} CellDB;
+
+extern CellDB *g_celldb;
+
+int open_celldb(const char *f_name, CellDB * db);
+void close_celldb(CellDB * db);
+void celldb_add(CellDB * db, FlipVal * flip);
+CellSlot *celldb_get(CellDB * db, uint64_t bank, uint64_t row, uint64_t col,
+		     uint8_t bit);
+size_t celldb_query(CellDB * db, uint64_t bank, uint64_t r_lo, uint64_t r_hi,
+		    void (*cb) (CellSlot * cell, void *arg), void *arg);
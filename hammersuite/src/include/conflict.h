@@ -0,0 +1,30 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+
+#define CONF_REPS	1000		// time_tuple() rounds per aggressor pair
+#define CONF_CALIB	1000		// random pairs timed for the threshold
+#define CONF_CALIB_REPS	100
+#define CONF_CACHE	(1 << 16)	// cached pairs, power of two
+
+#define CONF_WARN	1		// --check-conflicts
+#define CONF_SKIP	2		// --check-conflicts=skip
+
+/*
+ Pre-flight check of the DRAM mapping: aggressors the layout puts in the
+ same bank on different rows must show a row buffer conflict when timed
+ back to back (drama's time_tuple()). Results are cached per pair of
+ (bank, row) so every pair is timed once per session.
+ */
+typedef struct {
+	size_t pairs;		// distinct pairs timed
+	size_t fails;		// ... that did not conflict
+	size_t skipped;		// patterns not hammered
+	uint64_t thresh;	// cycles
+} ConflictStats;
+
+uint64_t time_tuple(volatile char *a1, volatile char *a2, size_t rounds);
+size_t check_conflicts(HammerPattern * h_patt, MemoryBuffer * mem);
+ConflictStats *get_conflict_stats();
+void export_conflict_stats();
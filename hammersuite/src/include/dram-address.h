@@ -9,10 +9,20 @@ typedef struct {
 	uint64_t len;
 } AddrFns;
 
+// DRAM dimension selected by a hash function, unlabeled functions select a bank
+typedef enum {
+	DIM_BK,
+	DIM_BG,
+	DIM_RK,
+	DIM_CH,
+	DIM_CNT
+} DRAMDim;
+
 typedef struct {
 	AddrFns h_fns;
 	uint64_t row_mask;
 	uint64_t col_mask;
+	uint64_t h_dims[HASH_FN_CNT];	// DRAMDim of every h_fn
 } DRAMLayout;
 
 typedef struct {
@@ -23,11 +33,26 @@ typedef struct {
 	uint64_t col;
 } DRAMAddr;
 
+// bank split along the labels of the layout, see dram_coord()
+typedef struct {
+	uint64_t ch;
+	uint64_t rk;
+	uint64_t bg;
+	uint64_t bk;
+} DRAMCoord;
+
 physaddr_t dram_2_phys(DRAMAddr d_addr);
 DRAMAddr phys_2_dram(physaddr_t p_addr);
 char *dram_2_str(DRAMAddr * d_addr);
 char *dramLayout_2_str(DRAMLayout * mem_layout);
 DRAMLayout *get_dram_layout();
 uint64_t get_banks_cnt();
+uint64_t get_banks_mask();
 bool d_addr_eq(DRAMAddr * d1, DRAMAddr * d2);
 bool d_addr_eq_row(DRAMAddr * d1, DRAMAddr * d2);
+uint64_t get_dim_mask(DRAMDim dim);
+uint64_t dram_dim(DRAMAddr * d_addr, DRAMDim dim);
+DRAMCoord dram_coord(DRAMAddr * d_addr);
+bool d_addr_eq_bg(DRAMAddr * d1, DRAMAddr * d2);
+uint64_t bank_at(uint64_t idx);
+uint64_t bank_idx(uint64_t bk);
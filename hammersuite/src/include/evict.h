@@ -0,0 +1,36 @@
+#pragma once
+
+#include "types.h"
+
+// how the aggressors are read and pushed out of the cache every round
+typedef enum {
+	FLUSH_CLFLUSHOPT,
+	FLUSH_CLFLUSH,
+	FLUSH_CLWB,
+	FLUSH_EVSET,		// no flush, eviction sets (see evset.h)
+	FLUSH_CNT
+} FlushOp;
+
+typedef enum {
+	FENCE_ROUND,		// mfence before every round
+	FENCE_ACCESS,		// mfence after every eviction
+	FENCE_NONE,
+	FENCE_CNT
+} FenceMode;
+
+#define FLUSH_AUTO	-1	// pick with evict_calibrate()
+#define CAL_ROUNDS	200000
+#define CAL_REPS	4096	// timed loads for the miss rate
+#define CAL_MISS_MIN	0.95
+
+typedef void (*HammerLoop) (char **v_lst, size_t len, size_t rounds);
+
+extern const char *flush_str[FLUSH_CNT];
+extern const char *fence_str[FENCE_CNT];
+
+int str2flush(const char *str);
+int str2fence(const char *str);
+bool flush_supported(int flush);
+uint64_t cache_threshold(char *v);
+HammerLoop get_hammer_loop(int flush, int fence);
+void evict_calibrate(MemoryBuffer * mem, int *flush, int *fence);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "types.h"
+
+#define EV_STRIDE	(1 << 17)	// keeps the LLC set index bits of the target
+#define EV_POOL		3072		// congruent candidates, enough for 64 slices x 16 ways
+#define EV_WAYS		16		// reduction stops at this size
+#define EV_TESTS	5		// majority vote of every eviction test
+#define EV_CACHE	4096		// cached sets, power of two
+#define EV_SAMPLE	256		// timed rounds of evset_report()
+
+/*
+ Flush-free eviction: every aggressor gets a minimal set of lines that
+ share its LLC set, reduced from a pool of congruent candidates with the
+ group testing of Vila et al. (split in EV_WAYS + 1 groups, drop any group
+ the set still evicts without). Sets are built on first use and kept for
+ the whole session.
+ */
+typedef struct {
+	uintptr_t key;		// line of the target, 0 = empty
+	char **lst;
+	size_t len;		// 0 if the reduction failed
+} EvSet;
+
+typedef struct {
+	size_t sets;		// built
+	size_t failed;
+	size_t lines;		// total size of the built sets
+	uint64_t build_ns;
+} EvStats;
+
+EvSet *get_evset(char *v, MemoryBuffer * mem);
+EvSet **get_evsets(char **v_lst, size_t len, MemoryBuffer * mem);
+void free_evsets();
+void evset_hammer(char **v_lst, EvSet ** sets, size_t len, size_t rounds, int fence);
+double evset_miss_rate(char **v_lst, EvSet ** sets, size_t len);
+double evset_report(char **v_lst, EvSet ** sets, size_t len);
+EvStats *get_evset_stats();
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+
+#define FLEET_MAX	64
+
+typedef struct {
+	int pid;
+	int cpu;		// -1 if not pinned
+	uint64_t jobs;
+	uint64_t flips;
+} FleetWorker;
+
+/*
+ Shared by the coordinator and its workers (anonymous shared mapping
+ created before fork()). Jobs are numbered 0..n_jobs-1 and every worker
+ runs all of them on its own banks, every update is a single atomic op.
+ */
+typedef struct {
+	uint64_t n_jobs;	// per worker
+	uint64_t jobs_done;
+	uint64_t flips;
+	int workers;
+	FleetWorker w[FLEET_MAX];
+} FleetShm;
+
+typedef void (*FleetJob) (int worker, uint64_t job, void *arg);
+
+int fleet_worker_id();
+uint64_t fleet_worker_banks(int worker);
+void fleet_on_flip(void *self, FlipVal * flip);
+FleetShm *fleet_run(uint64_t n_jobs, FleetJob job, void *arg, char *out_name);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+
+#define FS_MAGIC	0x7472726669707321ULL	// "trrfips!"
+#define FS_PREFIX	"/trrespass.flips."	// shm name is FS_PREFIX<pid> by default
+#define FS_CAP		(1 << 16)	// events in the ring, power of two
+
+/*
+ Stream of the flips found by the scans in a shared-memory ring, for
+ hammertime.flipstream to read while the run goes on. Every flip is one
+ fixed-size FlipEvent, published by storing its sequence number last:
+ slot i % FS_CAP holds event i once seq == i + 1. Readers never block the
+ tester and detect the events they were lapped on from seq. Fleet workers
+ claim their slots with an atomic add on the same ring.
+ */
+typedef struct {
+	uint64_t seq;		// event number + 1, 0 while written
+	uint64_t patt;		// pattern id, FlipRing.patterns when it started
+	uint32_t bank;		// victim
+	uint32_t row;
+	uint32_t col;
+	uint8_t exp;		// expected and read byte
+	uint8_t got;
+	uint8_t bits;		// exp ^ got
+	uint8_t up;		// bits that went 0 -> 1
+} FlipEvent;
+
+typedef struct {
+	uint64_t magic;
+	int64_t pid;
+	uint64_t cap;
+	uint64_t head;		// events claimed
+	uint64_t patterns;	// patterns started
+	uint64_t pad[3];
+	FlipEvent ev[FS_CAP];
+} FlipRing;
+
+extern FlipRing *g_flipring;
+
+int open_flipstream(const char *name);
+void close_flipstream();
+void flipstream_pattern();
+void flipstream_push(FlipVal * flip);
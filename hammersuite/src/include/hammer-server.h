@@ -0,0 +1,5 @@
+#pragma once
+
+#include "types.h"
+
+void serve_session(SessionConfig * cfg, MemoryBuffer * mem);
@@ -1,8 +1,97 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdio.h>
 
 #include "types.h"
+#include "dram-address.h"
+#include "addr-mapper.h"
+#include "utils.h"
+
+#define REFRESH_VAL "stdrefi"
+
+#define ROW_FIELD 		1
+#define COL_FIELD 		1<<1
+#define BK_FIELD 		1<<2
+#define P_FIELD			1<<3
+#define ALL_FIELDS		(ROW_FIELD | COL_FIELD | BK_FIELD)
+
+typedef struct {
+	DRAMAddr *d_lst;
+	size_t len;
+	size_t rounds;
+} HammerPattern;
+
+typedef struct {
+	DRAMAddr d_vict;
+	uint8_t f_og;
+	uint8_t f_new;
+	HammerPattern *h_patt;
+} FlipVal;
+
+typedef struct {
+	MemoryBuffer *mem;
+	SessionConfig *cfg;
+	DRAMAddr d_base;	// base address for hammering
+	ADDRMapper *mapper;	// dram mapper
+	uint8_t *row_dirty;	// (row, bank) of the chunk to re-init, NULL if not tracked
+
+	int (*hammer_test) (void *self);
+	void (*on_flip) (void *self, FlipVal * flip);	// called for every flip found, may be NULL
+	void *priv;		// private state of the current session
+	uint64_t banks;		// banks the chunk is kept for, see fleet.h
+} HammerSuite;
+
+#define ROW_CLS		(ROW_SIZE / CL_SIZE)
+#define HOT_LINES	4	// learnt sentinels, see --sample
+#define PROBE_ROUNDS	10000	// first round cost measurement, see --budget
+#define HALVING_BANKS_std	2	// banks a fuzzed pattern starts on, see --halving
+#define HALVING_ANOM	1.5	// access cost over the running average that counts as a hit
+// fuzzed shapes: aggressors, gap between pairs, victims in a pair (upper bounds excluded)
+#define FUZZ_LEN_MIN	2
+#define FUZZ_LEN_MAX	32
+#define FUZZ_D_MAX	16
+#define FUZZ_V_MAX	4
+
+// counters of the (sampled) scans, cumulative over the session
+typedef struct {
+	size_t rows;		// rows scanned
+	size_t escalated;	// sampled rows with a flipped sentinel
+	size_t lines;		// cache lines read
+	size_t sent;		// sentinels per row
+	size_t phase;
+	double miss_acc;
+	uint64_t hot[ROW_CLS];	// flips per line of the row
+} ScanStats;
+
+extern FILE *out_fd;
+
+char *dAddr_2_str(DRAMAddr d_addr, uint8_t fields);
+char *hPatt_2_str(HammerPattern * h_patt, int fields);
+void print_start_attack(HammerPattern * h_patt);
+void print_end_attack();
+uint64_t hammer_it(HammerPattern * patt, MemoryBuffer * mem);
+size_t budget_rounds(HammerSuite * suite, HammerPattern * h_patt, size_t dflt);
+uint64_t hammer_segmented(HammerSuite * suite, HammerPattern * h_patt);
+void spread_banks(HammerPattern * h_patt, uint64_t bk, int spread);
+uint64_t patt_banks(HammerPattern * h_patt);
+uint64_t hammer_pattern(HammerSuite * suite, HammerPattern * h_patt);
+void fill_row(HammerSuite * suite, DRAMAddr * d_addr, HammerData data_patt,
+	      int reverse);
+void init_chunk(HammerSuite * suite);
+size_t refresh_chunk(HammerSuite * suite);
+size_t verify_chunk(HammerSuite * suite);
+double scan_miss_prob();
+ScanStats *get_scan_stats();
+void export_scan_stats();
+void scan_rows(HammerSuite * suite, HammerPattern * h_patt, size_t adj_rows);
+
+HammerSuite *new_suite(SessionConfig * cfg, MemoryBuffer * mem, DRAMAddr d_base);
+void create_dir(const char *dir_name);
+void open_out_file(char *out_name, SessionConfig * cfg);
+uint64_t get_cl_seed();
+void set_cl_seed(uint64_t seed);
 
 void hammer_session(SessionConfig * cfg, MemoryBuffer * memory);
 void fuzzing_session(SessionConfig * cfg, MemoryBuffer * memory);
+void batch_session(SessionConfig * cfg, MemoryBuffer * memory);
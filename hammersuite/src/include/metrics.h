@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+
+#define METRICS_MAGIC	0x7472726d65747273ULL	// "trrmetrs"
+#define METRICS_PREFIX	"/trrespass."		// shm name is METRICS_PREFIX<pid> by default
+#define METRICS_BANKS	64
+#define METRICS_PATT	32		// aggressors of the current pattern kept
+
+/*
+ Live counters of a run in a named shared-memory page (/dev/shm), for
+ hammertime.metrics to poll. The counters are only ever added to, with
+ relaxed atomics once per hammer window, scan or flip, never inside the
+ hammer loop. Fleet workers share the page of their coordinator. The
+ current pattern is published under a sequence lock (odd while written)
+ with one writer at a time: a worker that finds it taken skips its turn.
+ */
+typedef struct {
+	uint64_t magic;
+	int64_t pid;
+	uint64_t start;		// unix time
+	uint64_t beat_ns;	// CLOCK_MONOTONIC of the last update
+	uint64_t patterns;	// hammer windows started
+	uint64_t rounds;
+	uint64_t acts;		// aggressor accesses
+	uint64_t hammer_ns;
+	uint64_t scan_bytes;
+	uint64_t scan_ns;
+	uint64_t flips;
+	uint64_t bank_flips[METRICS_BANKS];
+	uint64_t patt_seq;
+	uint64_t patt_len;
+	uint64_t patt[METRICS_PATT];	// bank << 32 | row
+} MetricsPage;
+
+extern MetricsPage *g_metrics;
+
+int open_metrics(const char *name);
+void close_metrics();
+void metrics_pattern(HammerPattern * h_patt);
+void metrics_hammer(HammerPattern * h_patt, size_t rounds, uint64_t ns);
+void metrics_scan(uint64_t bytes, uint64_t ns);
+void metrics_flip(FlipVal * flip);
@@ -14,10 +14,15 @@
 #define HUGETLB_std     "/mnt/huge/buff"
 #define CONFIG_NAME_std "tmp/s_cfg.bin"
 #define O_FILE_std      "DIMM00"
+#define SOCK_std        "/tmp/trrespass.sock"
 #define ALLOC_SIZE     	1<<30
 #define ALIGN_std       2<<20
 #define PATT_LEN 		1024
 #define AGGR_std		2
+#define VERIFY_std		64
+#define REPLAY_std		10
+#define TREFI_ns		7800		// DDR4, below 85C
+#define TREFW_ns		64000000
 #define HUGE_YES
 
 typedef struct ProfileParams {
@@ -35,6 +40,41 @@ typedef struct ProfileParams {
 	int		 huge_fd;
 	char     *conf_file		= (char *)CONFIG_NAME_std;
 	int 	 aggr			= AGGR_std;
+	int 	 numa_node		= -1;		// -1 = node of the calling cpu
+	int 	 serve			= 0;		// daemon mode
+	char 	*sock_path		= (char *)SOCK_std;
+	char 	*patt_file		= (char *)NULL;	// pattern spec for batch sessions
+	int 	 verify_every	= VERIFY_std;	// full chunk verify every N fuzzing iterations
+	size_t	 radius			= 0;		// rows scanned around the aggressors, 0 = whole chunk
+	int 	 sweep			= 0;		// walk every row of every bank
+	char 	*sweep_file		= (char *)NULL;	// sweep progress index
+	int 	 shard_i		= 0;
+	int 	 shard_n		= 1;
+	char 	*replay_file	= (char *)NULL;	// fliptable to replay
+	int 	 replay_n		= REPLAY_std;
+	int 	 celldb			= 0;		// keep the vulnerable cell db up to date
+	char 	*celldb_file	= (char *)NULL;
+	int 	 sample			= 1;		// scan 1 line out of N before the full row
+	int 	 segments		= 1;		// check the victims N times while hammering
+	uint64_t budget_ns		= 0;		// hammering time per pattern, 0 = fixed rounds
+	int 	 repeat			= 1;		// fuzzing runs per pattern shape, 0 = no dedup
+	int 	 fleet			= 1;		// worker processes
+	int 	 spread			= 1;		// banks per generated pattern
+	int 	 reorder		= 0;		// hammer in timing order instead of array order
+	int 	 order_bench	= 0;
+	int 	 flush			= 0;		// FlushOp of the hammer loop, -1 = calibrate
+	int 	 fence			= 0;		// FenceMode of the hammer loop
+	int 	 evict_bench	= 0;
+	int 	 trace			= 0;		// rounds per tracer sample, 0 = off
+	int 	 metrics		= 0;		// live counters in a shared-memory page
+	char 	*metrics_name	= (char *)NULL;
+	int 	 flipstream		= 0;		// flips to a shared-memory ring
+	char 	*flipstream_name	= (char *)NULL;
+	int 	 perf			= 0;		// perf_event_open() counters around windows and scans
+	int 	 pipeline		= 0;		// depth of the fuzzing pattern queue, 0 = no producer thread
+	int 	 halving		= 0;		// banks new fuzzing patterns start on, 0 = all of them
+	int 	 rt				= 0;		// SCHED_FIFO priority of the hammer windows, 0 = off
+	int 	 conflicts		= 0;		// check the aggressors conflict, 2 = skip those that don't
 } ProfileParams;
 
 int process_argv(int argc, char *argv[], ProfileParams *params);
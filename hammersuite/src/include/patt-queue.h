@@ -0,0 +1,50 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+#include "memory.h"
+
+#include <pthread.h>
+
+#define PQ_DEPTH_std	4		// patterns ready ahead of the hammer thread
+#define PQ_MAX_LEN	32		// aggressors per pattern
+
+/*
+ Fills h_patt->d_lst (PQ_MAX_LEN entries) with the next pattern on bank 0,
+ returns 0 to be called again (e.g. a duplicate). Runs on the producer
+ thread with the queue locked.
+ */
+typedef int (*PattGen) (void *ctx, HammerPattern * h_patt);
+
+// a pattern spread and translated for every bank, all in the arena
+typedef struct {
+	HammerPattern patt;	// bank 0
+	DRAMAddr *d_lst;	// patt.len aggressors per bank
+	char **v_lst;		// the same translated, in hammer order
+	size_t banks;
+} PattJob;
+
+/*
+ Bounded queue of ready to run patterns, filled by a producer thread so
+ the hammer thread never generates, allocates or translates. The jobs
+ live in a single arena allocated up front and are handed back with
+ patt_queue_done() once hammered and scanned.
+ */
+typedef struct {
+	PattJob *jobs;
+	size_t depth;
+	size_t head;		// jobs handed back
+	size_t tail;		// jobs produced
+	char *arena;
+	PattGen gen;
+	void *ctx;
+	MemoryBuffer *mem;
+	size_t waits;		// pops that found the queue empty
+	pthread_mutex_t lock;	// also held around gen()
+	pthread_cond_t ready, freed;
+	pthread_t thread;
+} PattQueue;
+
+void init_patt_queue(PattQueue * q, size_t depth, PattGen gen, void *ctx, MemoryBuffer * mem);
+PattJob *patt_queue_pop(PattQueue * q);
+void patt_queue_done(PattQueue * q);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+
+#define PSET_CAP_std	4096
+#define PSET_MAX_SKIPS	10000	// consecutive duplicates before the budget is raised
+
+/*
+ Set of the patterns tested so far, by canonical form: the row and bank
+ deltas of the aggressors (so the same shape at a different offset is the
+ same pattern) and the set of banks it was hammered on.
+ */
+typedef struct {
+	uint64_t *keys;		// 0 = empty
+	uint32_t *cnt;
+	size_t cap;		// power of two
+	size_t len;
+	size_t tested;		// patterns run
+	size_t skipped;		// duplicates over budget
+	size_t budget;		// runs allowed per pattern, 0 = no dedup
+	size_t skip_run;	// consecutive duplicates
+	size_t space;		// distinct shapes the fuzzer can draw, 0 if unknown
+	size_t full;		// shapes run budget times
+} PattSet;
+
+uint64_t canon_patt(HammerPattern * h_patt, uint64_t banks);
+void init_patt_set(PattSet * set, size_t cap);
+void free_patt_set(PattSet * set);
+size_t patt_set_get(PattSet * set, uint64_t key);
+size_t patt_set_add(PattSet * set, uint64_t key);
+void patt_set_raise(PattSet * set);
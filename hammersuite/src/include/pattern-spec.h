@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+
+/*
+ A pattern spec is a text file with one hammer pattern per line, made of
+ space separated key=value pairs. '#' starts a comment.
+
+	rows=0,2,4 banks=all rounds=1000000 data=random
+	rows=10-40:2 banks=0-7,16
+
+ rows	= aggressor rows relative to the base row, as a list of values
+	  and lo-hi[:step] ranges
+ banks	= "all" or a list of banks and lo-hi ranges	(default: all)
+	  "bank" is accepted too, the key of the first daemon protocol
+ spread	= aggressor pairs are spread over N banks from	(default: 1)
+	  each of the banks above, see spread_banks()
+ rounds	= hammering rounds per bank			(default: -r)
+ data	= random, i2o or o2i				(default: session data)
+ */
+
+#define SPEC_LINE_LEN	4096
+
+typedef struct {
+	HammerPattern h_patt;
+	HammerData d_cfg;
+	uint64_t banks;		// bitmask, get_banks_cnt() <= 64
+	int spread;		// banks per pattern
+} SpecEntry;
+
+typedef struct {
+	SpecEntry *lst;
+	size_t len;
+	DRAMAddr *d_arena;	// aggressors of every entry, back to back
+	size_t d_len;
+} PatternSpec;
+
+int parse_spec_line(char *line, SpecEntry * entry, HammerSuite * suite,
+		    char *err);
+int load_pattern_spec(const char *f_name, PatternSpec * spec,
+		      HammerSuite * suite);
+void free_pattern_spec(PatternSpec * spec);
+uint64_t run_spec_entry(HammerSuite * suite, SpecEntry * entry);
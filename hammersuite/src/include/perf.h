@@ -0,0 +1,60 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+
+#include <sys/types.h>
+
+#define PERF_IMC_MAX	16		// uncore memory controllers read for PERF_DRAM_RD
+
+// counters opened with --perf, each one is optional
+typedef enum {
+	PERF_CYCLES,
+	PERF_INSTR,
+	PERF_LLC_MISS,		// last level cache read misses
+	PERF_DTLB_MISS,
+	PERF_TASK_CLOCK,	// ns on cpu, software: always there
+	PERF_DRAM_RD,		// CAS reads of the uncore IMCs of the buffer socket
+	PERF_CNT
+} PerfCounter;
+
+// what the counters were wrapped around
+typedef enum {
+	PERF_HAMMER,
+	PERF_SCAN,
+	PERF_WIN_CNT
+} PerfWindow;
+
+extern const char *perf_str[];
+
+typedef struct {
+	uint64_t val[PERF_CNT];
+} PerfSample;
+
+typedef struct {
+	PerfSample acc[PERF_WIN_CNT];
+	size_t windows;
+	uint64_t rounds;	// hammered in the PERF_HAMMER windows
+	uint64_t acts;		// aggressor accesses issued
+} PerfStats;
+
+/*
+ Hardware counters around the hammer windows and the scans, opened with
+ perf_event_open() for the calling process. The IMCs are read for the
+ whole socket of the buffer node: PERF_DRAM_RD includes every other
+ process on it, the other fleet workers included. Counters the cpu, the
+ kernel or perf_event_paranoid do not
+ allow are left out with a warning, the rest keep working: without
+ PERF_DRAM_RD the DRAM accesses are estimated from the LLC misses.
+ */
+void init_perf();
+void perf_begin(PerfSample * s);
+void perf_end(PerfSample * s, PerfWindow win, size_t rounds, size_t len);
+bool perf_has(PerfCounter c);
+// per pattern counters, reset by perf_pattern()
+void perf_pattern();
+PerfStats *get_perf_pattern();
+PerfStats *get_perf_stats();
+double perf_dram_per_round(PerfStats * st);
+void export_perf_pattern();
+void export_perf_stats();
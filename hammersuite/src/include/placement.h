@@ -0,0 +1,22 @@
+#pragma once
+
+#include "types.h"
+
+#define MAX_NODES	64
+
+typedef struct {
+	int node;		// NUMA node backing the buffer (-1 if unknown)
+	int hammer_cpu;		// core running hammer_it() (-1 if not pinned)
+	int scan_cpu;		// core running scan_rows() (-1 if not pinned)
+	int *cpus;		// usable cores on the node
+	int cpu_cnt;
+} Placement;
+
+int get_local_node();
+int get_buffer_node(MemoryBuffer * mem);
+int bind_buffer(char *addr, uint64_t size, int node);
+int get_node_cpus(int node, int *cpus, int max);
+int pin_to_cpu(int cpu);
+void init_placement(MemoryBuffer * mem, bool pin);
+Placement *get_placement();
+char *placement_2_str(Placement * pl);
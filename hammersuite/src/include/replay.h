@@ -0,0 +1,47 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+
+/*
+ Replays the patterns that produced flips in a fliptable file. Every
+ pattern is rebuilt with the rounds, data pattern and seed in effect when
+ it was recorded (the "# { ... }" metadata lines), then the whole set is
+ hammered --replay-n times.
+ */
+
+typedef struct {
+	uint64_t row;
+	uint64_t bank;
+	uint64_t col;
+	uint8_t bit;
+	uint8_t f_og;		// original value of the bit
+	size_t hits;		// reps that flipped it again
+	size_t last;		// last rep counted
+} ReplayCell;
+
+typedef struct {
+	HammerPattern h_patt;
+	HammerData d_cfg;
+	uint64_t seed;
+	uint64_t r_min, r_max;
+	size_t c_off, c_len;	// cells in ReplayState.cells
+	size_t hits;		// reps with at least one known cell flipping
+	size_t fresh;		// flips on cells not in the original run
+	size_t last;
+} ReplayPattern;
+
+typedef struct {
+	ReplayPattern *lst;
+	size_t len;
+	DRAMAddr *d_arena;
+	size_t d_len;
+	ReplayCell *cells;
+	size_t c_len;
+	ReplayPattern *cur;	// pattern being hammered
+	size_t rep;
+} ReplayState;
+
+int load_replay(const char *f_name, ReplayState * st);
+void free_replay(ReplayState * st);
+void replay_session(SessionConfig * cfg, MemoryBuffer * mem);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.h"
+#include "utils.h"
+
+#define RT_PRIO_std	50		// SCHED_FIFO priority of --rt
+#define RT_GAP_ns	10000		// a round this much over the window average was disturbed
+
+/*
+ Real-time hammer windows: with --rt every hammer_it() window runs under
+ SCHED_FIFO on the pinned core with all memory locked, and the longest
+ round of the window is recorded. A round takes from well under a
+ microsecond to tens of them for long spec patterns, so the longest one
+ is compared to the average round of its own window: RT_GAP_ns more is a
+ preemption or an interrupt, not a refresh.
+ */
+typedef struct {
+	uint64_t t0, last;	// tsc
+	uint64_t ns0;
+	uint64_t max_gap;	// cycles
+	uint64_t ticks;		// rounds
+} RTWindow;
+
+typedef struct {
+	size_t windows;
+	size_t disturbed;
+	uint64_t max_gap_ns;	// worst round over all the windows
+	uint64_t gap_acc_ns;	// sum of the per window max gaps
+} RTStats;
+
+void init_rt();
+void rt_enter(RTWindow * w);
+void rt_leave(RTWindow * w);
+RTStats *get_rt_stats();
+void export_rt_stats();
+
+static inline __attribute__ ((always_inline))
+void rt_tick(RTWindow * w)
+{
+	uint64_t now = rdtsc();
+	if (now - w->last > w->max_gap)
+		w->max_gap = now - w->last;
+	w->last = now;
+	w->ticks++;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "types.h"
+
+#define SWEEP_MAGIC	0x7472727377656570ULL	// "trrsweep"
+
+/*
+ On-disk progress index of a sweep: one bit per (row, bank, pattern)
+ tuple, rows are absolute DRAM rows so that every process sweeping the
+ same DIMM, whatever its buffer, can share the same index.
+ */
+typedef struct {
+	uint64_t magic;
+	uint64_t rows;		// DRAM rows covered by the row mask
+	uint64_t banks;
+	uint64_t patts;
+	uint64_t done;		// completed tuples
+} SweepHeader;
+
+typedef struct {
+	SweepHeader *hdr;
+	uint64_t *bits;
+	size_t size;		// bytes mapped
+	int fd;
+} SweepIndex;
+
+int open_sweep_index(const char *f_name, SweepIndex * idx, uint64_t patts);
+bool sweep_done(SweepIndex * idx, uint64_t row, uint64_t bank, uint64_t patt);
+void sweep_mark(SweepIndex * idx, uint64_t row, uint64_t bank, uint64_t patt);
+void close_sweep_index(SweepIndex * idx);
+
+void sweep_session(SessionConfig * cfg, MemoryBuffer * mem);
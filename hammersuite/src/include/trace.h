@@ -0,0 +1,56 @@
+#pragma once
+
+#include "types.h"
+#include "hammer-suite.h"
+#include "utils.h"
+
+#include <sys/types.h>
+
+#define TRACE_MAGIC	0x7472727472616365ULL	// "trrtrace"
+#define TRACE_K_std	64		// rounds per sample
+#define TRACE_CAP	(1 << 16)	// samples kept per window, power of two
+
+/*
+ Sampled timeline of the hammer windows: every K rounds the tsc delta
+ since the previous sample goes into a preallocated ring, so the loop
+ only pays one rdtscp and a store every K rounds. At the end of the
+ window the ring is appended to DATA_DIR<o_file>.trace as a TraceRecord,
+ the aggressors (bank << 32 | row each) and the uint32_t deltas, oldest
+ first. Refresh stalls, TRR and preemption show up as slow samples.
+ */
+typedef struct {
+	uint64_t magic;
+	uint64_t seq;		// window number in this file
+	uint64_t k;
+	uint64_t rounds;
+	uint64_t len;		// aggressors
+	uint64_t samples;	// deltas that follow
+	uint64_t dropped;	// oldest samples overwritten in the ring
+	uint64_t cycles;	// tsc and wall time of the whole window
+	uint64_t ns;
+} TraceRecord;
+
+typedef struct {
+	uint32_t *ring;
+	uint64_t head;		// samples taken in this window
+	uint64_t last;		// tsc of the previous sample
+	uint64_t t0, ns0;
+	uint64_t seq;
+	FILE *fp;
+	pid_t pid;		// owner of fp, forked workers open their own
+} Trace;
+
+extern Trace g_trace;
+
+void trace_begin();
+void trace_end(HammerPattern * h_patt, size_t rounds);
+void close_trace();
+
+static inline __attribute__ ((always_inline))
+void trace_tick()
+{
+	uint64_t now = rdtscp();
+	uint64_t delta = now - g_trace.last;
+	g_trace.ring[g_trace.head++ & (TRACE_CAP - 1)] = delta > UINT32_MAX ? UINT32_MAX : delta;
+	g_trace.last = now;
+}
@@ -51,4 +51,5 @@ typedef struct {
 	uint64_t size;		// in bytes
 	uint64_t align;
 	uint64_t flags;		// from params
+	int node;			// NUMA node to bind to (-1 = local)
 } MemoryBuffer;
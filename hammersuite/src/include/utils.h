@@ -24,11 +24,13 @@
 #define F_CONFIG			BIT_SET(2)
 #define F_NO_OVERWRITE		BIT_SET(3)
 #define MEM_SHIFT			(30L)
-#define MEM_MASK			0b11111ULL << MEM_SHIFT
+#define MEM_MASK			0b111111ULL << MEM_SHIFT
 #define F_ALLOC_HUGE 		BIT_SET(MEM_SHIFT)
 #define F_ALLOC_HUGE_1G 	F_ALLOC_HUGE | BIT_SET(MEM_SHIFT+1)
 #define F_ALLOC_HUGE_2M		F_ALLOC_HUGE | BIT_SET(MEM_SHIFT+2)
 #define F_POPULATE			BIT_SET(MEM_SHIFT+3)
+#define F_NUMA_BIND			BIT_SET(MEM_SHIFT+4)
+#define F_ALLOC_SHARED		BIT_SET(MEM_SHIFT+5)	// forked workers hammer the same frames
 
 #define NOT_FOUND 	((void*) -1)
 #define	NOT_OPENED  -1
@@ -55,6 +57,13 @@ void clflushopt(volatile void *p)
 #endif
 }
 
+// write back without invalidating on most parts, see evict_calibrate()
+static inline __attribute__ ((always_inline))
+void clwb(volatile void *p)
+{
+	asm volatile ("clwb (%0)\n"::"r" (p):"memory");
+}
+
 static inline __attribute__ ((always_inline))
 void cpuid()
 {
@@ -22,13 +22,25 @@
 #include "include/dram-address.h"
 #include "include/hammer-suite.h"
 #include "include/params.h"
+#include "include/placement.h"
+#include "include/hammer-server.h"
+#include "include/sweep.h"
+#include "include/replay.h"
+#include "include/celldb.h"
+#include "include/access-order.h"
+#include "include/evict.h"
+#include "include/rt.h"
+#include "include/trace.h"
+#include "include/metrics.h"
+#include "include/flipstream.h"
+#include "include/perf.h"
 
 ProfileParams *p;
 
 // DRAMLayout     g_mem_layout = {{{0x4080,0x88000,0x110000,0x220000,0x440000,0x4b300}, 6}, 0xffff80000, ((1<<13)-1)};
 // DRAMLayout 			g_mem_layout = { {{0x2040, 0x44000, 0x88000, 0x110000, 0x220000}, 5}, 0xffffc0000, ((1 << 13) - 1) };
 // DRAMLayout 			g_mem_layout = {{{0x2040,0x24000,0x48000,0x90000},4}, 0xffffe0000, ((1<<13)-1)};
-DRAMLayout      g_mem_layout = {{{0x4080,0x48000,0x90000,0x120000,0x1b300}, 5}, 0xffffc0000, ROW_SIZE-1};
+DRAMLayout      g_mem_layout = {{{0x4080,0x48000,0x90000,0x120000,0x1b300}, 5}, 0xffffc0000, ROW_SIZE-1, {DIM_BG,DIM_BG,DIM_BK,DIM_BK,DIM_CH}};
 
 void read_config(SessionConfig * cfg, char *f_name)
 {
@@ -82,12 +94,37 @@ int main(int argc, char **argv)
 		.fd = p->huge_fd,
 		.size = p->m_size,
 		.align = p->m_align,
-		.flags = p->g_flags & MEM_MASK
+		.flags = p->g_flags & MEM_MASK,
+		.node = p->numa_node
 	};
 
 	alloc_buffer(&mem);
 	set_physmap(&mem);
+	init_placement(&mem, p->g_flags & F_NUMA_BIND);
+	fprintf(stderr, "[LOG] - Placement: %s\n", placement_2_str(get_placement()));
 	gmem_dump();
+	if (p->rt)
+		init_rt();
+	if (p->perf)
+		init_perf();
+	if (p->metrics && open_metrics(p->metrics_name))
+		exit(1);
+	if (p->flipstream && open_flipstream(p->flipstream_name))
+		exit(1);
+
+	CellDB c_db;
+	if (p->celldb) {
+		char *db_name = p->celldb_file;
+		if (db_name == NULL) {
+			create_dir(DATA_DIR);
+			db_name = (char *)malloc(500);
+			sprintf(db_name, "%s%s.cells.db", DATA_DIR, p->g_out_prefix);
+		}
+		if (open_celldb(db_name, &c_db))
+			exit(1);
+		g_celldb = &c_db;
+		fprintf(stderr, "[LOG] - Cell db: %s (%ld cells)\n", db_name, c_db.hdr->cells);
+	}
 
 	SessionConfig s_cfg;
 	memset(&s_cfg, 0, sizeof(SessionConfig));
@@ -103,12 +140,36 @@ int main(int argc, char **argv)
 		s_cfg.aggr_n = p->aggr;
 	}
 
-	if (p->fuzzing) {
+	if (p->flush == FLUSH_AUTO || p->evict_bench)
+		evict_calibrate(&mem, &p->flush, &p->fence);
+	if (!flush_supported(p->flush)) {
+		fprintf(stderr, "[ERROR] - %s not supported on this cpu\n", flush_str[p->flush]);
+		exit(1);
+	}
+
+	if (p->evict_bench) {
+		// calibration only
+	} else if (p->order_bench) {
+		order_bench(&s_cfg, &mem);
+	} else if (p->serve) {
+		serve_session(&s_cfg, &mem);
+	} else if (p->replay_file != NULL) {
+		replay_session(&s_cfg, &mem);
+	} else if (p->sweep) {
+		sweep_session(&s_cfg, &mem);
+	} else if (p->patt_file != NULL) {
+		batch_session(&s_cfg, &mem);
+	} else if (p->fuzzing) {
 		fuzzing_session(&s_cfg, &mem);
 	} else {
 		hammer_session(&s_cfg, &mem);
 	}
 
+	if (g_celldb != NULL)
+		close_celldb(g_celldb);
+	close_trace();
+	close_metrics();
+	close_flipstream();
 	close(p->huge_fd);
 	return 0;
 }
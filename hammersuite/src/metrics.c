@@ -0,0 +1,118 @@
+#include "metrics.h"
+
+#include "utils.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+MetricsPage *g_metrics = NULL;
+
+static char shm_name[256];
+
+#define ADD(field, val)	__atomic_fetch_add(&g_metrics->field, (val), __ATOMIC_RELAXED)
+
+int open_metrics(const char *name)
+{
+	if (name == NULL) {
+		sprintf(shm_name, "%s%d", METRICS_PREFIX, getpid());
+	} else {
+		snprintf(shm_name, sizeof(shm_name), "%s%s", name[0] == '/' ? "" : "/", name);
+	}
+
+	int fd = shm_open(shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd == -1) {
+		perror("[ERROR] - shm_open() of metrics page failed");
+		return -1;
+	}
+	if (ftruncate(fd, PAGE_SIZE) == -1) {
+		perror("[ERROR] - Unable to size metrics page");
+		close(fd);
+		return -1;
+	}
+	g_metrics = (MetricsPage *) mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+					 MAP_SHARED, fd, 0);
+	close(fd);
+	if (g_metrics == MAP_FAILED) {
+		perror("[ERROR] - mmap() of metrics page failed");
+		g_metrics = NULL;
+		return -1;
+	}
+
+	memset(g_metrics, 0, sizeof(MetricsPage));
+	g_metrics->pid = getpid();
+	g_metrics->start = time(NULL);
+	g_metrics->beat_ns = realtime_now();
+	__atomic_store_n(&g_metrics->magic, METRICS_MAGIC, __ATOMIC_RELEASE);
+	fprintf(stderr, "[LOG] - Metrics: /dev/shm%s\n", shm_name);
+	return 0;
+}
+
+// the page goes away with the run, monitors see it disappear
+void close_metrics()
+{
+	if (g_metrics == NULL)
+		return;
+	munmap(g_metrics, PAGE_SIZE);
+	shm_unlink(shm_name);
+	g_metrics = NULL;
+}
+
+void metrics_pattern(HammerPattern * h_patt)
+{
+	if (g_metrics == NULL)
+		return;
+	ADD(patterns, 1);
+
+	/*
+	 The sequence lock only holds with one writer: the odd value is taken
+	 with a CAS and a fleet worker that finds it odd skips its pattern,
+	 the page shows the one being written.
+	 */
+	uint64_t seq = __atomic_load_n(&g_metrics->patt_seq, __ATOMIC_RELAXED);
+	if (seq % 2 || !__atomic_compare_exchange_n(&g_metrics->patt_seq, &seq, seq + 1, false,
+						    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		return;
+	// the odd value must be visible before any of the stores below
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	size_t len = h_patt->len < METRICS_PATT ? h_patt->len : METRICS_PATT;
+	__atomic_store_n(&g_metrics->patt_len, h_patt->len, __ATOMIC_RELAXED);
+	for (size_t i = 0; i < len; i++)
+		__atomic_store_n(&g_metrics->patt[i],
+				 (h_patt->d_lst[i].bank << 32) | h_patt->d_lst[i].row, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_metrics->patt_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void metrics_hammer(HammerPattern * h_patt, size_t rounds, uint64_t ns)
+{
+	if (g_metrics == NULL)
+		return;
+	ADD(rounds, rounds);
+	ADD(acts, rounds * h_patt->len);
+	ADD(hammer_ns, ns);
+	__atomic_store_n(&g_metrics->beat_ns, realtime_now(), __ATOMIC_RELAXED);
+}
+
+void metrics_scan(uint64_t bytes, uint64_t ns)
+{
+	if (g_metrics == NULL)
+		return;
+	ADD(scan_bytes, bytes);
+	ADD(scan_ns, ns);
+	__atomic_store_n(&g_metrics->beat_ns, realtime_now(), __ATOMIC_RELAXED);
+}
+
+void metrics_flip(FlipVal * flip)
+{
+	if (g_metrics == NULL)
+		return;
+	ADD(flips, 1);
+	if (flip->d_vict.bank < METRICS_BANKS)
+		ADD(bank_flips[flip->d_vict.bank], 1);
+}
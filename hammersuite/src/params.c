@@ -19,6 +19,13 @@
 
 #include "include/params.h"
 #include "include/utils.h"
+#include "include/evict.h"
+#include "include/conflict.h"
+#include "include/rt.h"
+#include "include/trace.h"
+#include "include/metrics.h"
+#include "include/flipstream.h"
+#include "include/patt-queue.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -32,7 +39,7 @@
 void print_usage(char *bin_name)
 {
 	fprintf(stderr,
-		"[ HELP ] - Usage ./%s [-h] [-r rounds] [-a aggr] [-o o_file] [-v] [--mem mem_size] [--[huge/HUGE] f_name] [--conf f_name] [--align val] [--off val] [--no-overwrite] [--fuzzing]\n",
+		"[ HELP ] - Usage ./%s [-h] [-r rounds] [-a aggr] [-o o_file] [-v] [--mem mem_size] [--[huge/HUGE] f_name] [--conf f_name] [--align val] [--off val] [--no-overwrite] [--fuzzing] [--numa[=node]] [--serve[=sock]] [--patterns f_name] [--verify-every N] [--radius N] [--sweep[=idx]] [--shard i/n] [--replay f_name] [--replay-n N] [--celldb[=f_name]] [--sample N] [--segments N] [--budget N[refi|refw]] [--repeat N] [--fleet N] [--spread N] [--reorder] [--order-bench] [--flush op] [--fence mode] [--evict-bench] [--check-conflicts[=skip]] [--rt[=prio]] [--trace[=K]] [--metrics[=name]] [--flip-stream[=name]] [--perf] [--pipeline[=depth]] [--halving[=N]]\n",
 		bin_name);
 	fprintf(stderr, "\t-h\t\t\t= this help message\n");
 	fprintf(stderr, "\t-v\t\t\t= verbose\n\n");
@@ -53,6 +60,52 @@ void print_usage(char *bin_name)
 	fprintf(stderr, "\t-T --target-pattern\t= hex value for the target pattern\n");
 	fprintf(stderr, "\t-f --fuzzing\t\t= Start fuzzing (--aggr will be ignored)\n");
 	fprintf(stderr, "\t-t --threshold\t\t= Align the hammering to refresh ops,\n\t\t\t\t looking at the memory latency in CPU cycles.\t(default: 0)\n");
+	fprintf(stderr, "\t--spread N\t\t= spread the victim-sharing aggressor runs of generated patterns over N banks\t(default: 1)\n");
+	fprintf(stderr, "\t--reorder\t\t= access the aggressors of a round in the order with the fewest bank timing stalls\n");
+	fprintf(stderr, "\t--order-bench\t\t= compare activation rates of array and timing order on random patterns\n");
+	fprintf(stderr, "\t--flush op\t\t= clflushopt, clflush, clwb, evset (eviction sets) or auto (calibrate)\t(default: clflushopt)\n");
+	fprintf(stderr, "\t--fence mode\t\t= mfence every round, access or none\t(default: round)\n");
+	fprintf(stderr, "\t--evict-bench\t\t= time every flush/fence combination and exit\n");
+	fprintf(stderr, "\t--check-conflicts[=skip]\t= time the aggressors of every pattern for row conflicts, skip the patterns that fail\n");
+	fprintf(stderr, "\t--rt[=prio]\t\t= hammer under SCHED_FIFO with locked memory on a dedicated core, report jitter\t(default prio: %d)\n", RT_PRIO_std);
+	fprintf(stderr, "\t--trace[=K]\t\t= sample the tsc every K rounds of every hammer window into %s<o_file>.trace\t(default K: %d)\n", DATA_DIR, TRACE_K_std);
+	fprintf(stderr, "\t--metrics[=name]\t= publish live counters in /dev/shm/<name> for hammertime.metrics\t(default: %s<pid>)\n", METRICS_PREFIX + 1);
+	fprintf(stderr, "\t--flip-stream[=name]\t= stream the flips through a ring in /dev/shm/<name> for hammertime.flipstream\t(default: %s<pid>)\n", FS_PREFIX + 1);
+	fprintf(stderr, "\t--perf\t\t\t= count cycles, instructions, LLC/dTLB misses and DRAM reads around hammer windows and scans, per pattern\n");
+	fprintf(stderr, "\t--pipeline[=depth]\t= generate and translate the fuzzing patterns ahead on a producer thread\t(default depth: %d)\n", PQ_DEPTH_std);
+	fprintf(stderr, "\t--halving[=N]\t\t= fuzz new patterns on N banks, doubling while they flip or slow down\t(default N: %d)\n", HALVING_BANKS_std);
+	fprintf(stderr, "\t--numa[=node]\t\t= bind the buffer to a NUMA node and pin to its cores\t(default: local node)\n");
+	fprintf(stderr, "\t--patterns f_name\t= run every pattern of a pattern spec file in one session\n");
+	fprintf(stderr, "\t--verify-every N\t= full chunk verify every N fuzzing iterations\t(default: %d)\n", VERIFY_std);
+	fprintf(stderr, "\t--radius N\t\t= only scan N rows around the aggressors\t(default: 0, whole chunk)\n");
+	fprintf(stderr, "\t--sample N\t\t= check 1 cache line out of N per row, full row only on flips\t(default: 1, every line)\n");
+	fprintf(stderr, "\t--segments N\t\t= split the rounds in N segments, stop at the first flip\t(default: 1)\n");
+	fprintf(stderr, "\t--budget N[refi|refw]\t= hammer every pattern for N tREFI/tREFW instead of -r rounds\n");
+	fprintf(stderr, "\t--repeat N\t\t= fuzz every pattern shape at most N times, 0 = no dedup\t(default: 1)\n");
+	fprintf(stderr, "\t--sweep[=idx]\t\t= hammer every row of every bank, progress kept in idx\t(default: %s<o_file>.sweep.idx)\n", DATA_DIR);
+	fprintf(stderr, "\t--shard i/n\t\t= only sweep the i-th of n shards\t\t\t(default: 0/1)\n");
+	fprintf(stderr, "\t--replay f_name\t\t= re-hammer the patterns that flipped in a fliptable\n");
+	fprintf(stderr, "\t--replay-n N\t\t= replay repetitions\t\t\t\t(default: %d)\n", REPLAY_std);
+	fprintf(stderr, "\t--celldb[=f_name]\t= record every flip in a vulnerable cell db\t(default: %s<o_file>.cells.db)\n", DATA_DIR);
+	fprintf(stderr, "\t--fleet N\t\t= sweep with N worker processes, one core and a share of the banks each\t(default: 1)\n");
+	fprintf(stderr, "\t--serve[=sock]\t\t= keep the buffer warm and serve hammer jobs on a unix socket\t(default: %s)\n", SOCK_std);
+}
+
+// "N", "Nrefi" or "Nrefw", N can be fractional
+static int str2budget(const char *str, uint64_t *ns)
+{
+	char *endp = NULL;
+	double val = strtod(str, &endp);
+
+	if (endp == str || val <= 0)
+		return EINVAL;
+	if (*endp == '\0' || strcmp(endp, "refi") == 0)
+		*ns = val * TREFI_ns;
+	else if (strcmp(endp, "refw") == 0)
+		*ns = val * TREFW_ns;
+	else
+		return EINVAL;
+	return 0;
 }
 
 static int str2pat(const char *str, char **pat)
@@ -102,6 +155,41 @@ int process_argv(int argc, char *argv[], ProfileParams *p)
 	p->huge_file = (char *)HUGETLB_std;
 	p->conf_file = (char *)CONFIG_NAME_std;
 	p->aggr      = AGGR_std;
+	p->numa_node = -1;
+	p->serve     = 0;
+	p->sock_path = (char *)SOCK_std;
+	p->patt_file = (char *)NULL;
+	p->verify_every = VERIFY_std;
+	p->radius    = 0;
+	p->sweep     = 0;
+	p->sweep_file = (char *)NULL;
+	p->shard_i   = 0;
+	p->shard_n   = 1;
+	p->replay_file = (char *)NULL;
+	p->replay_n  = REPLAY_std;
+	p->celldb    = 0;
+	p->celldb_file = (char *)NULL;
+	p->sample    = 1;
+	p->segments  = 1;
+	p->budget_ns = 0;
+	p->repeat    = 1;
+	p->fleet     = 1;
+	p->spread    = 1;
+	p->reorder   = 0;
+	p->order_bench = 0;
+	p->flush     = FLUSH_CLFLUSHOPT;
+	p->fence     = FENCE_ROUND;
+	p->evict_bench = 0;
+	p->conflicts = 0;
+	p->rt        = 0;
+	p->trace     = 0;
+	p->metrics   = 0;
+	p->metrics_name = NULL;
+	p->flipstream = 0;
+	p->flipstream_name = NULL;
+	p->perf      = 0;
+	p->pipeline  = 0;
+	p->halving   = 0;
 
 
 	const struct option long_options[] = {
@@ -118,6 +206,35 @@ int process_argv(int argc, char *argv[], ProfileParams *p)
 		{.name = "aggr",.has_arg = required_argument,.flag = NULL,.val='a'},
 		{.name = "fuzzing",.has_arg = no_argument,.flag = &p->fuzzing,.val = 1},
 		{.name = "threshold",.has_arg = required_argument,.flag = NULL,.val = 't'},
+		{"numa", optional_argument, 0, 0},
+		{"serve", optional_argument, 0, 0},
+		{"patterns", required_argument, 0, 0},
+		{"verify-every", required_argument, 0, 0},
+		{"radius", required_argument, 0, 0},
+		{"sweep", optional_argument, 0, 0},
+		{"shard", required_argument, 0, 0},
+		{"replay", required_argument, 0, 0},
+		{"replay-n", required_argument, 0, 0},
+		{"celldb", optional_argument, 0, 0},
+		{"sample", required_argument, 0, 0},
+		{"segments", required_argument, 0, 0},
+		{"budget", required_argument, 0, 0},
+		{"repeat", required_argument, 0, 0},
+		{"fleet", required_argument, 0, 0},
+		{"spread", required_argument, 0, 0},
+		{"reorder", no_argument, 0, 0},
+		{"order-bench", no_argument, 0, 0},
+		{"flush", required_argument, 0, 0},
+		{"fence", required_argument, 0, 0},
+		{"evict-bench", no_argument, 0, 0},
+		{"check-conflicts", optional_argument, 0, 0},
+		{"rt", optional_argument, 0, 0},
+		{"trace", optional_argument, 0, 0},
+		{"metrics", optional_argument, 0, 0},
+		{"flip-stream", optional_argument, 0, 0},
+		{"perf", no_argument, 0, 0},
+		{"pipeline", optional_argument, 0, 0},
+		{"halving", optional_argument, 0, 0},
 		{0, 0, 0, 0}
 	};
 
@@ -162,6 +279,145 @@ int process_argv(int argc, char *argv[], ProfileParams *p)
 			case 6:
 				p->g_flags |= F_NO_OVERWRITE;
 				break;
+			case 12:
+				p->g_flags |= F_NUMA_BIND;
+				if (optarg)
+					p->numa_node = atoi(optarg);
+				break;
+			case 13:
+				p->serve = 1;
+				if (optarg)
+					p->sock_path = optarg;
+				break;
+			case 14:
+				p->patt_file = optarg;
+				break;
+			case 15:
+				p->verify_every = atoi(optarg);
+				break;
+			case 16:
+				p->radius = atoi(optarg);
+				break;
+			case 17:
+				p->sweep = 1;
+				if (optarg)
+					p->sweep_file = optarg;
+				break;
+			case 18:
+				if (sscanf(optarg, "%d/%d", &p->shard_i, &p->shard_n) != 2
+				    || p->shard_n < 1 || p->shard_i < 0
+				    || p->shard_i >= p->shard_n) {
+					fprintf(stderr, "Invalid shard: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 19:
+				p->replay_file = optarg;
+				break;
+			case 20:
+				p->replay_n = atoi(optarg);
+				break;
+			case 21:
+				p->celldb = 1;
+				if (optarg)
+					p->celldb_file = optarg;
+				break;
+			case 22:
+				p->sample = atoi(optarg);
+				break;
+			case 23:
+				p->segments = atoi(optarg);
+				break;
+			case 24:
+				if (str2budget(optarg, &p->budget_ns)) {
+					fprintf(stderr, "Invalid budget: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 25:
+				p->repeat = atoi(optarg);
+				break;
+			case 26:
+				p->fleet = atoi(optarg);
+				if (p->fleet > 1)
+					p->g_flags |= F_ALLOC_SHARED;
+				break;
+			case 27:
+				p->spread = atoi(optarg);
+				break;
+			case 28:
+				p->reorder = 1;
+				break;
+			case 29:
+				p->order_bench = 1;
+				break;
+			case 30:
+				p->flush = str2flush(optarg);
+				if (p->flush < FLUSH_AUTO) {
+					fprintf(stderr, "Invalid flush: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 31:
+				p->fence = str2fence(optarg);
+				if (p->fence < 0) {
+					fprintf(stderr, "Invalid fence: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 32:
+				p->evict_bench = 1;
+				break;
+			case 33:
+				p->conflicts = CONF_WARN;
+				if (optarg && strcmp(optarg, "skip") == 0) {
+					p->conflicts = CONF_SKIP;
+				} else if (optarg) {
+					fprintf(stderr, "Invalid check-conflicts: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 34:
+				p->rt = optarg ? atoi(optarg) : RT_PRIO_std;
+				if (p->rt < 1 || p->rt > 99) {
+					fprintf(stderr, "Invalid rt priority: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 35:
+				p->trace = optarg ? atoi(optarg) : TRACE_K_std;
+				if (p->trace < 1) {
+					fprintf(stderr, "Invalid trace interval: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 36:
+				p->metrics = 1;
+				if (optarg)
+					p->metrics_name = optarg;
+				break;
+			case 37:
+				p->flipstream = 1;
+				if (optarg)
+					p->flipstream_name = optarg;
+				break;
+			case 38:
+				p->perf = 1;
+				break;
+			case 39:
+				p->pipeline = optarg ? atoi(optarg) : PQ_DEPTH_std;
+				if (p->pipeline < 1) {
+					fprintf(stderr, "Invalid pipeline depth: %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 40:
+				p->halving = optarg ? atoi(optarg) : HALVING_BANKS_std;
+				if (p->halving < 1) {
+					fprintf(stderr, "Invalid halving banks: %s\n", optarg);
+					return -1;
+				}
+				break;
 			default:
 				break;
 			}
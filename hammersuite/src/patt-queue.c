@@ -0,0 +1,142 @@
+#include "patt-queue.h"
+
+#include "access-order.h"
+#include "dram-address.h"
+#include "params.h"
+#include "placement.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern ProfileParams *p;
+
+static void translate(PattQueue * q, PattJob * job, size_t * order)
+{
+	HammerPattern h_patt = job->patt;
+	size_t len = job->patt.len;
+
+	for (size_t bk = 0; bk < job->banks; bk++) {
+		h_patt.d_lst = job->d_lst + bk * len;
+		for (size_t i = 0; i < len; i++)
+			h_patt.d_lst[i] = job->patt.d_lst[i];
+		spread_banks(&h_patt, bk, p->spread);
+
+		char **v_lst = job->v_lst + bk * len;
+		if (p->reorder)
+			order_accesses(get_lat_matrix(q->mem), &h_patt, order);
+		for (size_t i = 0; i < len; i++)
+			v_lst[i] = phys_2_virt(dram_2_phys(h_patt.d_lst[p->reorder ? order[i] : i]), q->mem);
+	}
+}
+
+static void *producer(void *arg)
+{
+	PattQueue *q = (PattQueue *) arg;
+	size_t order[PQ_MAX_LEN];
+
+	for (;;) {
+		pthread_mutex_lock(&q->lock);
+		while (q->tail - q->head == q->depth)
+			pthread_cond_wait(&q->freed, &q->lock);
+		PattJob *job = &q->jobs[q->tail % q->depth];
+		while (!q->gen(q->ctx, &job->patt)) ;
+		pthread_mutex_unlock(&q->lock);
+
+		assert(job->patt.len <= PQ_MAX_LEN);
+		translate(q, job, order);
+
+		pthread_mutex_lock(&q->lock);
+		q->tail++;
+		pthread_cond_signal(&q->ready);
+		pthread_mutex_unlock(&q->lock);
+	}
+	return NULL;
+}
+
+/*
+ The thread inherits the affinity of the hammer core, where it would
+ preempt the hammering after every patt_queue_done(): move it to another
+ core of the node. Returns the core, -1 if left to the scheduler.
+ */
+static int pin_producer(PattQueue * q)
+{
+	Placement *pl = get_placement();
+
+	if (pl->hammer_cpu == -1)
+		return -1;
+	for (int i = 0; i < pl->cpu_cnt; i++) {
+		if (pl->cpus[i] == pl->hammer_cpu)
+			continue;
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(pl->cpus[i], &set);
+		if (pthread_setaffinity_np(q->thread, sizeof(cpu_set_t), &set) == 0)
+			return pl->cpus[i];
+	}
+	fprintf(stderr, "[WARN] - No core but the hammer core %d, the producer shares it\n",
+		pl->hammer_cpu);
+	return pl->hammer_cpu;
+}
+
+void init_patt_queue(PattQueue * q, size_t depth, PattGen gen, void *ctx, MemoryBuffer * mem)
+{
+	size_t banks = get_banks_cnt();
+	size_t base = sizeof(DRAMAddr) * PQ_MAX_LEN;
+	size_t slot = base + (sizeof(DRAMAddr) + sizeof(char *)) * PQ_MAX_LEN * banks;
+
+	q->depth = depth;
+	q->head = q->tail = 0;
+	q->gen = gen;
+	q->ctx = ctx;
+	q->mem = mem;
+	q->waits = 0;
+	q->jobs = (PattJob *) calloc(depth, sizeof(PattJob));
+	q->arena = (char *)malloc(slot * depth);
+	if (q->jobs == NULL || q->arena == NULL) {
+		fprintf(stderr, "[ERROR] - Unable to allocate the pattern queue\n");
+		exit(1);
+	}
+	for (size_t i = 0; i < depth; i++) {
+		char *s = q->arena + i * slot;
+		q->jobs[i].patt.d_lst = (DRAMAddr *) s;
+		q->jobs[i].d_lst = (DRAMAddr *) (s + base);
+		q->jobs[i].v_lst = (char **)(s + base + sizeof(DRAMAddr) * PQ_MAX_LEN * banks);
+		q->jobs[i].banks = banks;
+	}
+	// built lazily otherwise, and not by two threads at once
+	if (p->reorder)
+		get_lat_matrix(mem);
+
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->ready, NULL);
+	pthread_cond_init(&q->freed, NULL);
+	if (pthread_create(&q->thread, NULL, producer, q) != 0) {
+		perror("[ERROR] - Unable to start the pattern producer");
+		exit(1);
+	}
+	fprintf(stderr, "[LOG] - Pattern queue: %ld deep, %ld KB arena, producer on cpu %d\n",
+		depth, slot * depth / 1024, pin_producer(q));
+}
+
+PattJob *patt_queue_pop(PattQueue * q)
+{
+	pthread_mutex_lock(&q->lock);
+	if (q->tail == q->head)
+		q->waits++;
+	while (q->tail == q->head)
+		pthread_cond_wait(&q->ready, &q->lock);
+	PattJob *job = &q->jobs[q->head % q->depth];
+	pthread_mutex_unlock(&q->lock);
+	return job;
+}
+
+// the job from the last patt_queue_pop() can be reused
+void patt_queue_done(PattQueue * q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->head++;
+	pthread_cond_signal(&q->freed);
+	pthread_mutex_unlock(&q->lock);
+}
@@ -0,0 +1,98 @@
+#include "patt-set.h"
+#include "dram-address.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t mix(uint64_t h, uint64_t val)
+{
+	h ^= val + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	h ^= h >> 31;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	return h ^ (h >> 29);
+}
+
+uint64_t canon_patt(HammerPattern * h_patt, uint64_t banks)
+{
+	uint64_t h = mix(h_patt->len, banks);
+
+	for (size_t i = 1; i < h_patt->len; i++) {
+		h = mix(h, h_patt->d_lst[i].row - h_patt->d_lst[0].row);
+		h = mix(h, (h_patt->d_lst[i].bank - h_patt->d_lst[0].bank) % get_banks_cnt());
+	}
+	// 0 marks the empty slots
+	return h ? h : 1;
+}
+
+void init_patt_set(PattSet * set, size_t cap)
+{
+	memset(set, 0x00, sizeof(PattSet));
+	set->cap = cap;
+	set->keys = (uint64_t *) calloc(cap, sizeof(uint64_t));
+	set->cnt = (uint32_t *) calloc(cap, sizeof(uint32_t));
+}
+
+void free_patt_set(PattSet * set)
+{
+	free(set->keys);
+	free(set->cnt);
+}
+
+static size_t find_slot(PattSet * set, uint64_t key)
+{
+	size_t i = key & (set->cap - 1);
+	while (set->keys[i] != 0 && set->keys[i] != key)
+		i = (i + 1) & (set->cap - 1);
+	return i;
+}
+
+static void grow(PattSet * set)
+{
+	PattSet old = *set;
+
+	set->cap *= 2;
+	set->keys = (uint64_t *) calloc(set->cap, sizeof(uint64_t));
+	set->cnt = (uint32_t *) calloc(set->cap, sizeof(uint32_t));
+	for (size_t i = 0; i < old.cap; i++) {
+		if (old.keys[i] == 0)
+			continue;
+		size_t j = find_slot(set, old.keys[i]);
+		set->keys[j] = old.keys[i];
+		set->cnt[j] = old.cnt[i];
+	}
+	free_patt_set(&old);
+}
+
+// times key was added so far
+size_t patt_set_get(PattSet * set, uint64_t key)
+{
+	size_t i = find_slot(set, key);
+	return set->keys[i] == key ? set->cnt[i] : 0;
+}
+
+// returns the new count of key
+size_t patt_set_add(PattSet * set, uint64_t key)
+{
+	if (2 * (set->len + 1) > set->cap)
+		grow(set);
+	size_t i = find_slot(set, key);
+	if (set->keys[i] == 0) {
+		set->keys[i] = key;
+		set->len++;
+	}
+	if (++set->cnt[i] == set->budget)
+		set->full++;
+	return set->cnt[i];
+}
+
+// one more run allowed per pattern
+void patt_set_raise(PattSet * set)
+{
+	set->budget++;
+	set->skip_run = 0;
+	set->full = 0;
+	for (size_t i = 0; i < set->cap; i++) {
+		if (set->keys[i] != 0 && set->cnt[i] >= set->budget)
+			set->full++;
+	}
+}
@@ -0,0 +1,263 @@
+#include "pattern-spec.h"
+
+#include "dram-address.h"
+#include "params.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int parse_data(const char *val, HammerData * d_cfg)
+{
+	for (int i = 0; i < (int)(sizeof(data_str) / sizeof(data_str[0])); i++) {
+		if (strcmp(val, data_str[i]) == 0) {
+			*d_cfg = (HammerData) i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// "lo", "lo-hi" or "lo-hi:step"
+static int parse_range(char *tok, size_t * lo, size_t * hi, size_t * step)
+{
+	char *end;
+	*lo = strtoul(tok, &end, 0);
+	if (end == tok)
+		return -1;
+	*hi = *lo;
+	*step = 1;
+	if (*end == '-') {
+		tok = end + 1;
+		*hi = strtoul(tok, &end, 0);
+		if (end == tok || *hi < *lo)
+			return -1;
+	}
+	if (*end == ':') {
+		tok = end + 1;
+		*step = strtoul(tok, &end, 0);
+		if (end == tok || *step == 0)
+			return -1;
+	}
+	return *end == '\0' ? 0 : -1;
+}
+
+static int parse_rows(char *val, SpecEntry * entry, HammerSuite * suite,
+		      char *err)
+{
+	HammerPattern *h_patt = &entry->h_patt;
+	char *save = NULL;
+	size_t lo, hi, step;
+
+	for (char *tok = strtok_r(val, ",", &save); tok != NULL;
+	     tok = strtok_r(NULL, ",", &save)) {
+		if (parse_range(tok, &lo, &hi, &step)) {
+			sprintf(err, "malformed rows %.32s", tok);
+			return -1;
+		}
+		for (size_t row = lo; row <= hi; row += step) {
+			if (row >= suite->cfg->h_rows) {
+				sprintf(err, "row %ld out of [0, %ld)", row,
+					suite->cfg->h_rows);
+				return -1;
+			}
+			if (h_patt->len == PATT_LEN) {
+				sprintf(err, "more than %d rows", PATT_LEN);
+				return -1;
+			}
+			h_patt->d_lst[h_patt->len] = suite->d_base;
+			h_patt->d_lst[h_patt->len].row += row;
+			h_patt->d_lst[h_patt->len].col = 0;
+			h_patt->len++;
+		}
+	}
+	return 0;
+}
+
+static int parse_banks(char *val, SpecEntry * entry, char *err)
+{
+	char *save = NULL;
+	size_t lo, hi, step;
+
+	if (strcmp(val, "all") == 0) {
+		entry->banks = get_banks_mask();
+		return 0;
+	}
+	entry->banks = 0;
+	for (char *tok = strtok_r(val, ",", &save); tok != NULL;
+	     tok = strtok_r(NULL, ",", &save)) {
+		if (parse_range(tok, &lo, &hi, &step) || hi >= get_banks_cnt()) {
+			sprintf(err, "malformed banks %.32s", tok);
+			return -1;
+		}
+		for (size_t bk = lo; bk <= hi; bk += step)
+			entry->banks |= BIT_SET(bk);
+	}
+	return 0;
+}
+
+/*
+ entry->h_patt.d_lst must have room for PATT_LEN addresses.
+ Returns 0 on success, 1 if the line holds no pattern and -1 on error
+ (with a description in err).
+ */
+int parse_spec_line(char *line, SpecEntry * entry, HammerSuite * suite,
+		    char *err)
+{
+	char *save = NULL;
+	char *cmt = strchr(line, '#');
+	if (cmt != NULL)
+		*cmt = '\0';
+
+	entry->h_patt.len = 0;
+	entry->h_patt.rounds = suite->cfg->h_rounds;
+	entry->d_cfg = suite->cfg->d_cfg;
+	entry->banks = get_banks_mask();
+	entry->spread = 1;
+
+	int found = 0;
+	for (char *tok = strtok_r(line, " \t\r\n", &save); tok != NULL;
+	     tok = strtok_r(NULL, " \t\r\n", &save)) {
+		char *val = strchr(tok, '=');
+		if (val == NULL) {
+			sprintf(err, "malformed token %.32s", tok);
+			return -1;
+		}
+		*val++ = '\0';
+		found = 1;
+
+		if (strcmp(tok, "rows") == 0) {
+			if (parse_rows(val, entry, suite, err))
+				return -1;
+		} else if (strcmp(tok, "banks") == 0 || strcmp(tok, "bank") == 0) {
+			if (parse_banks(val, entry, err))
+				return -1;
+		} else if (strcmp(tok, "spread") == 0) {
+			entry->spread = atoi(val);
+			if (entry->spread < 1 || (uint64_t) entry->spread > get_banks_cnt()) {
+				sprintf(err, "spread %.16s out of [1, %ld]", val, get_banks_cnt());
+				return -1;
+			}
+		} else if (strcmp(tok, "rounds") == 0) {
+			entry->h_patt.rounds = strtoul(val, NULL, 0);
+		} else if (strcmp(tok, "data") == 0) {
+			if (parse_data(val, &entry->d_cfg)) {
+				sprintf(err, "unknown data pattern %.16s", val);
+				return -1;
+			}
+		} else {
+			sprintf(err, "unknown key %.16s", tok);
+			return -1;
+		}
+	}
+
+	if (!found)
+		return 1;
+	if (entry->h_patt.len == 0) {
+		sprintf(err, "missing rows");
+		return -1;
+	}
+	if (entry->banks == 0) {
+		sprintf(err, "empty bank set");
+		return -1;
+	}
+	return 0;
+}
+
+// The whole file is compiled at once: every aggressor list ends up in a
+// single arena so that running the spec never allocates.
+int load_pattern_spec(const char *f_name, PatternSpec * spec,
+		      HammerSuite * suite)
+{
+	char line[SPEC_LINE_LEN];
+	char err[128];
+	size_t cap = 64, d_cap = 1024, line_n = 0;
+	size_t *offs;
+	SpecEntry entry;
+
+	FILE *fp = fopen(f_name, "r");
+	if (fp == NULL) {
+		perror("[ERROR] - Unable to open pattern spec");
+		return -1;
+	}
+
+	spec->len = 0;
+	spec->d_len = 0;
+	spec->lst = (SpecEntry *) malloc(sizeof(SpecEntry) * cap);
+	spec->d_arena = (DRAMAddr *) malloc(sizeof(DRAMAddr) * d_cap);
+	offs = (size_t *) malloc(sizeof(size_t) * cap);
+	entry.h_patt.d_lst = (DRAMAddr *) malloc(sizeof(DRAMAddr) * PATT_LEN);
+
+	while (fgets(line, SPEC_LINE_LEN, fp) != NULL) {
+		line_n++;
+		int res = parse_spec_line(line, &entry, suite, err);
+		if (res == 1)
+			continue;
+		if (res == -1) {
+			fprintf(stderr, "[ERROR] - %s:%ld: %s\n", f_name, line_n, err);
+			fclose(fp);
+			free(offs);
+			free(entry.h_patt.d_lst);
+			free_pattern_spec(spec);
+			return -1;
+		}
+
+		if (spec->len == cap) {
+			cap *= 2;
+			spec->lst = (SpecEntry *) realloc(spec->lst, sizeof(SpecEntry) * cap);
+			offs = (size_t *) realloc(offs, sizeof(size_t) * cap);
+		}
+		while (spec->d_len + entry.h_patt.len > d_cap) {
+			d_cap *= 2;
+			spec->d_arena = (DRAMAddr *) realloc(spec->d_arena,
+							     sizeof(DRAMAddr) * d_cap);
+		}
+		memcpy(spec->d_arena + spec->d_len, entry.h_patt.d_lst,
+		       sizeof(DRAMAddr) * entry.h_patt.len);
+		offs[spec->len] = spec->d_len;
+		spec->lst[spec->len] = entry;
+		spec->d_len += entry.h_patt.len;
+		spec->len++;
+	}
+	fclose(fp);
+
+	// the arena does not move anymore
+	for (size_t i = 0; i < spec->len; i++) {
+		spec->lst[i].h_patt.d_lst = spec->d_arena + offs[i];
+	}
+	free(offs);
+	free(entry.h_patt.d_lst);
+	return 0;
+}
+
+void free_pattern_spec(PatternSpec * spec)
+{
+	free(spec->lst);
+	free(spec->d_arena);
+	spec->lst = NULL;
+	spec->d_arena = NULL;
+	spec->len = 0;
+	spec->d_len = 0;
+}
+
+// the chunk is expected to be initialized for the session data pattern
+uint64_t run_spec_entry(HammerSuite * suite, SpecEntry * entry)
+{
+	SessionConfig *cfg = suite->cfg;
+	HammerPattern *h_patt = &entry->h_patt;
+	uint64_t time = 0;
+
+	if (entry->d_cfg != cfg->d_cfg) {
+		cfg->d_cfg = entry->d_cfg;
+		init_chunk(suite);
+	}
+
+	for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
+		if (!(entry->banks & BIT_SET(bk)))
+			continue;
+		spread_banks(h_patt, bk, entry->spread);
+		time += hammer_pattern(suite, h_patt);
+	}
+	return time;
+}
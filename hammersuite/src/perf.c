@@ -0,0 +1,291 @@
+#include "perf.h"
+
+#include "params.h"
+#include "placement.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern ProfileParams *p;
+
+const char *perf_str[] = {
+	"cycles", "instr", "llc_miss", "dtlb_miss", "task_ns", "dram_rd"
+};
+
+static int fds[PERF_CNT - 1] = { -1, -1, -1, -1, -1 };
+static int imc_fds[PERF_IMC_MAX];
+static size_t imc_cnt = 0;
+static pid_t owner = 0;		// counters follow the process that opened them
+static bool warned = false;
+
+static PerfStats patt_stats;
+static PerfStats stats;
+
+static int perf_open(uint32_t type, uint64_t config, pid_t pid, int cpu)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = pid != -1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, pid, cpu, -1, 0);
+}
+
+static uint64_t cache_cfg(uint64_t cache)
+{
+	return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+	    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+/*
+ Uncore PMUs list one cpu per socket in their cpumask ("0,28" or "0-1"):
+ the counters of the memory controllers of the buffer node are read on
+ the one that belongs to it, the first one if the node is not known.
+ */
+static int node_cpu(char *mask)
+{
+	Placement *pl = get_placement();
+	int first = -1;
+
+	for (char *tok = strtok(mask, ",\n"); tok != NULL; tok = strtok(NULL, ",\n")) {
+		char *end;
+		int lo = strtol(tok, &end, 10), hi = lo;
+		if (*end == '-')
+			hi = strtol(end + 1, NULL, 10);
+		for (int cpu = lo; cpu <= hi; cpu++) {
+			if (first == -1)
+				first = cpu;
+			for (int i = 0; pl->node != -1 && i < pl->cpu_cnt; i++) {
+				if (pl->cpus[i] == cpu)
+					return cpu;
+			}
+		}
+	}
+	return first == -1 ? 0 : first;
+}
+
+// "event=0x04,umask=0x03" from sysfs, 0 if the pmu has no such event
+static uint64_t sysfs_event(const char *pmu, const char *event, int *type, int *cpu)
+{
+	char f_name[256], buf[256];
+	unsigned int ev = 0, umask = 0;
+	FILE *fp;
+
+	sprintf(f_name, "/sys/bus/event_source/devices/%s/type", pmu);
+	if ((fp = fopen(f_name, "r")) == NULL)
+		return 0;
+	if (fscanf(fp, "%d", type) != 1)
+		*type = -1;
+	fclose(fp);
+	sprintf(f_name, "/sys/bus/event_source/devices/%s/cpumask", pmu);
+	*cpu = 0;
+	if ((fp = fopen(f_name, "r")) != NULL) {
+		if (fgets(buf, sizeof(buf), fp) != NULL)
+			*cpu = node_cpu(buf);
+		fclose(fp);
+	}
+	sprintf(f_name, "/sys/bus/event_source/devices/%s/events/%s", pmu, event);
+	if ((fp = fopen(f_name, "r")) == NULL)
+		return 0;
+	if (fgets(buf, sizeof(buf), fp) == NULL)
+		buf[0] = '\0';
+	fclose(fp);
+	for (char *tok = strtok(buf, ",\n"); tok != NULL; tok = strtok(NULL, ",\n")) {
+		if (!strncmp(tok, "event=", 6))
+			ev = strtoul(tok + 6, NULL, 0);
+		else if (!strncmp(tok, "umask=", 6))
+			umask = strtoul(tok + 6, NULL, 0);
+	}
+	return *type == -1 ? 0 : ev | (umask << 8);
+}
+
+static void open_counters()
+{
+	const struct {
+		uint32_t type;
+		uint64_t config;
+	} ev[PERF_CNT - 1] = {
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		{PERF_TYPE_HW_CACHE, cache_cfg(PERF_COUNT_HW_CACHE_LL)},
+		{PERF_TYPE_HW_CACHE, cache_cfg(PERF_COUNT_HW_CACHE_DTLB)},
+		{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+	};
+
+	for (int c = 0; c < PERF_CNT - 1; c++) {
+		if (fds[c] != -1)
+			close(fds[c]);
+		fds[c] = perf_open(ev[c].type, ev[c].config, 0, -1);
+	}
+	for (size_t i = 0; i < imc_cnt; i++)
+		close(imc_fds[i]);
+	imc_cnt = 0;
+	for (int i = 0; i < PERF_IMC_MAX; i++) {
+		char pmu[32];
+		int type, cpu;
+		sprintf(pmu, "uncore_imc_%d", i);
+		uint64_t cfg = sysfs_event(pmu, "cas_count_read", &type, &cpu);
+		if (cfg == 0)
+			continue;
+		int fd = perf_open(type, cfg, -1, cpu);
+		if (fd != -1)
+			imc_fds[imc_cnt++] = fd;
+	}
+	owner = getpid();
+}
+
+void init_perf()
+{
+	char avail[256] = "", miss[256] = "";
+
+	open_counters();
+	for (int c = 0; c < PERF_CNT; c++) {
+		char *s = perf_has((PerfCounter) c) ? avail : miss;
+		strcat(s, " ");
+		strcat(s, perf_str[c]);
+	}
+	fprintf(stderr, "[LOG] - Perf counters:%s\n", avail);
+	if (miss[0] != '\0') {
+		fprintf(stderr, "[WARN] - Perf counters not available:%s\n", miss);
+		warned = true;
+	}
+}
+
+bool perf_has(PerfCounter c)
+{
+	if (c == PERF_DRAM_RD)
+		return imc_cnt > 0;
+	return fds[c] != -1;
+}
+
+static void perf_read(PerfSample * s)
+{
+	for (int c = 0; c < PERF_CNT - 1; c++) {
+		s->val[c] = 0;
+		if (fds[c] != -1 && read(fds[c], &s->val[c], sizeof(uint64_t)) != sizeof(uint64_t))
+			s->val[c] = 0;
+	}
+	s->val[PERF_DRAM_RD] = 0;
+	for (size_t i = 0; i < imc_cnt; i++) {
+		uint64_t v = 0;
+		if (read(imc_fds[i], &v, sizeof(uint64_t)) == sizeof(uint64_t))
+			s->val[PERF_DRAM_RD] += v;
+	}
+}
+
+void perf_begin(PerfSample * s)
+{
+	// fleet workers inherit the fds of the coordinator's counters
+	if (owner != getpid()) {
+		open_counters();
+		if (!warned && !perf_has(PERF_CYCLES)) {
+			fprintf(stderr, "[WARN] - Perf counters not available in worker %d\n", getpid());
+			warned = true;
+		}
+	}
+	perf_read(s);
+}
+
+void perf_end(PerfSample * s, PerfWindow win, size_t rounds, size_t len)
+{
+	PerfSample now;
+
+	perf_read(&now);
+	for (int c = 0; c < PERF_CNT; c++) {
+		s->val[c] = now.val[c] - s->val[c];
+		patt_stats.acc[win].val[c] += s->val[c];
+		stats.acc[win].val[c] += s->val[c];
+	}
+	if (win == PERF_HAMMER) {
+		patt_stats.windows++;
+		stats.windows++;
+		patt_stats.rounds += rounds;
+		stats.rounds += rounds;
+		patt_stats.acts += rounds * len;
+		stats.acts += rounds * len;
+	}
+}
+
+void perf_pattern()
+{
+	memset(&patt_stats, 0, sizeof(PerfStats));
+}
+
+PerfStats *get_perf_pattern()
+{
+	return &patt_stats;
+}
+
+PerfStats *get_perf_stats()
+{
+	return &stats;
+}
+
+// accesses that left the cache per hammered round, -1 if nothing counts them
+double perf_dram_per_round(PerfStats * st)
+{
+	PerfSample *h = &st->acc[PERF_HAMMER];
+
+	if (st->rounds == 0)
+		return -1;
+	if (perf_has(PERF_DRAM_RD))
+		return (double)h->val[PERF_DRAM_RD] / st->rounds;
+	if (perf_has(PERF_LLC_MISS))
+		return (double)h->val[PERF_LLC_MISS] / st->rounds;
+	return -1;
+}
+
+static void export_perf(PerfStats * st, const char *prefix)
+{
+	PerfSample *h = &st->acc[PERF_HAMMER];
+	PerfSample *s = &st->acc[PERF_SCAN];
+
+	fprintf(out_fd, "# { %swindows: %ld", prefix, st->windows);
+	for (int c = 0; c < PERF_CNT; c++) {
+		if (perf_has((PerfCounter) c))
+			fprintf(out_fd, ", %s: %ld", perf_str[c], h->val[c]);
+	}
+	if (perf_has(PERF_CYCLES) && perf_has(PERF_TASK_CLOCK) && h->val[PERF_TASK_CLOCK])
+		fprintf(out_fd, ", ghz: %.2f", (double)h->val[PERF_CYCLES] / h->val[PERF_TASK_CLOCK]);
+	double dram = perf_dram_per_round(st);
+	if (dram >= 0 && st->acts) {
+		// 1.0 per aggressor when every access reached DRAM
+		fprintf(out_fd, ", dram_per_round: %.2f, dram_hit: %.3f", dram,
+			dram * st->rounds / st->acts);
+	}
+	if (perf_has(PERF_LLC_MISS))
+		fprintf(out_fd, ", scan_llc_miss: %ld", s->val[PERF_LLC_MISS]);
+	if (perf_has(PERF_TASK_CLOCK))
+		fprintf(out_fd, ", scan_ns: %ld", s->val[PERF_TASK_CLOCK]);
+	fprintf(out_fd, " }\n");
+}
+
+void export_perf_pattern()
+{
+	if (!p->perf || out_fd == NULL || patt_stats.windows == 0)
+		return;
+	export_perf(&patt_stats, "perf_");
+	perf_pattern();
+}
+
+void export_perf_stats()
+{
+	if (!p->perf || out_fd == NULL)
+		return;
+	double dram = perf_dram_per_round(&stats);
+	fprintf(stderr, "[LOG] - Perf: %ld windows, %ld rounds", stats.windows, stats.rounds);
+	if (dram >= 0)
+		fprintf(stderr, ", %.2f DRAM accesses/round (%s)", dram,
+			perf_has(PERF_DRAM_RD) ? "imc" : "llc misses");
+	fprintf(stderr, "\n");
+	export_perf(&stats, "perf_total_");
+	fflush(out_fd);
+}
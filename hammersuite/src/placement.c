@@ -0,0 +1,155 @@
+#include "placement.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+
+#include "utils.h"
+
+// from <numaif.h>, we talk to the kernel directly to avoid pulling in libnuma
+#ifndef MPOL_BIND
+#define MPOL_BIND 		2
+#endif
+#ifndef MPOL_MF_STRICT
+#define MPOL_MF_STRICT	(1<<0)
+#endif
+
+#define NODE_CPULIST "/sys/devices/system/node/node%d/cpulist"
+
+static Placement g_placement = {
+	.node = -1,
+	.hammer_cpu = -1,
+	.scan_cpu = -1,
+	.cpus = NULL,
+	.cpu_cnt = 0
+};
+
+Placement *get_placement()
+{
+	return &g_placement;
+}
+
+int get_local_node()
+{
+	unsigned int cpu, node;
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) == -1)
+		return -1;
+	return (int)node;
+}
+
+// query-only move_pages() returns the node currently backing the page
+int get_buffer_node(MemoryBuffer * mem)
+{
+	void *pages[2] = { mem->buffer, mem->buffer + mem->size - 1 };
+	int status[2] = { -1, -1 };
+
+	if (syscall(SYS_move_pages, 0, 2, pages, NULL, status, 0) == -1)
+		return -1;
+	if (status[0] != status[1]) {
+		fprintf(stderr, "[WARN] - Buffer spans nodes %d and %d\n",
+			status[0], status[1]);
+	}
+	return status[0];
+}
+
+// Must be called before the pages are faulted in, otherwise the policy
+// only applies to future allocations.
+int bind_buffer(char *addr, uint64_t size, int node)
+{
+	unsigned long mask = 0;
+	if (node < 0 || node >= MAX_NODES) {
+		fprintf(stderr, "[ERROR] - Invalid NUMA node %d\n", node);
+		return -1;
+	}
+	mask = 1UL << node;
+	if (syscall(SYS_mbind, addr, size, MPOL_BIND, &mask, MAX_NODES + 1,
+		    MPOL_MF_STRICT) == -1) {
+		perror("[ERROR] - mbind() failed");
+		return -1;
+	}
+	return 0;
+}
+
+// cpulist is in the "0-3,8-11" format. Only cores in our affinity mask are kept.
+int get_node_cpus(int node, int *cpus, int max)
+{
+	char path[64];
+	char line[1024];
+	cpu_set_t allowed;
+	int cnt = 0;
+
+	sprintf(path, NODE_CPULIST, node);
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL)
+		return 0;
+	if (fgets(line, sizeof(line), fp) == NULL) {
+		fclose(fp);
+		return 0;
+	}
+	fclose(fp);
+
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(cpu_set_t), &allowed);
+
+	char *tok = strtok(line, ",\n");
+	while (tok != NULL && cnt < max) {
+		int lo, hi;
+		if (sscanf(tok, "%d-%d", &lo, &hi) != 2)
+			hi = lo = atoi(tok);
+		for (int cpu = lo; cpu <= hi && cnt < max; cpu++) {
+			if (CPU_ISSET(cpu, &allowed))
+				cpus[cnt++] = cpu;
+		}
+		tok = strtok(NULL, ",\n");
+	}
+	return cnt;
+}
+
+int pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(cpu_set_t), &set) == -1) {
+		perror("[ERROR] - sched_setaffinity() failed");
+		return -1;
+	}
+	return 0;
+}
+
+void init_placement(MemoryBuffer * mem, bool pin)
+{
+	Placement *pl = &g_placement;
+	pl->node = get_buffer_node(mem);
+	if (pl->node < 0)
+		pl->node = get_local_node();
+
+	pl->cpus = (int *)malloc(sizeof(int) * CPU_SETSIZE);
+	pl->cpu_cnt = get_node_cpus(pl->node, pl->cpus, CPU_SETSIZE);
+
+	if (!pin || pl->cpu_cnt == 0)
+		return;
+
+	// stay away from cpu0, it gets most of the interrupts
+	int cpu = pl->cpus[0];
+	if (cpu == 0 && pl->cpu_cnt > 1)
+		cpu = pl->cpus[1];
+
+	// hammering and scanning run on the same thread
+	if (pin_to_cpu(cpu) == 0) {
+		pl->hammer_cpu = cpu;
+		pl->scan_cpu = cpu;
+	}
+}
+
+char *placement_2_str(Placement * pl)
+{
+	static char ret_str[128];
+	sprintf(ret_str, "node: %d, hammer_cpu: %d, scan_cpu: %d, node_cpus: %d",
+		pl->node, pl->hammer_cpu, pl->scan_cpu, pl->cpu_cnt);
+	return ret_str;
+}
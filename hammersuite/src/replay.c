@@ -0,0 +1,376 @@
+#include "replay.h"
+
+#include "hammer-suite.h"
+#include "dram-address.h"
+#include "addr-mapper.h"
+#include "memory.h"
+#include "params.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern ProfileParams *p;
+
+static int parse_data(const char *val, HammerData * d_cfg)
+{
+	for (int i = 0; i < (int)(sizeof(data_str) / sizeof(data_str[0])); i++) {
+		if (strncmp(val, data_str[i], strlen(data_str[i])) == 0) {
+			*d_cfg = (HammerData) i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// "# { h_rounds: N, d_cfg: X, seed: 0xS }", every key is optional
+static void parse_meta(char *line, size_t *rounds, HammerData * d_cfg,
+		       uint64_t *seed)
+{
+	char *val;
+
+	if ((val = strstr(line, "h_rounds: ")) != NULL)
+		*rounds = strtoul(val + strlen("h_rounds: "), NULL, 10);
+	if ((val = strstr(line, "d_cfg: ")) != NULL)
+		parse_data(val + strlen("d_cfg: "), d_cfg);
+	if ((val = strstr(line, "seed: ")) != NULL)
+		*seed = strtoull(val + strlen("seed: "), NULL, 16);
+}
+
+static void add_cells(ReplayState * st, size_t *c_cap, DRAMAddr d_vict,
+		      uint8_t f_og, uint8_t f_new)
+{
+	uint8_t diff = f_og ^ f_new;
+
+	for (int b = 0; b < 8; b++) {
+		if (!(diff & BIT_SET(b)))
+			continue;
+		if (st->c_len == *c_cap) {
+			*c_cap *= 2;
+			st->cells = (ReplayCell *) realloc(st->cells,
+							    sizeof(ReplayCell) * *c_cap);
+		}
+		ReplayCell *cell = &st->cells[st->c_len++];
+		cell->row = d_vict.row;
+		cell->bank = d_vict.bank;
+		cell->col = d_vict.col;
+		cell->bit = b;
+		cell->f_og = (f_og >> b) & 1;
+		cell->hits = 0;
+		cell->last = 0;
+	}
+}
+
+/*
+ Only fliptable lines with at least one flip are kept:
+
+	r00012.bk03/r00014.bk03 : ff,fe,r00013.bk03.col0012 ...
+ */
+int load_replay(const char *f_name, ReplayState * st)
+{
+	char *line = NULL;
+	size_t l_cap = 0, cap = 64, d_cap = 1024, c_cap = 1024, line_n = 0;
+	size_t rounds = p->rounds;
+	HammerData d_cfg = RANDOM;
+	uint64_t seed = get_cl_seed();
+	size_t *offs;
+
+	FILE *fp = fopen(f_name, "r");
+	if (fp == NULL) {
+		perror("[ERROR] - Unable to open fliptable");
+		return -1;
+	}
+
+	memset(st, 0x00, sizeof(ReplayState));
+	st->lst = (ReplayPattern *) malloc(sizeof(ReplayPattern) * cap);
+	st->d_arena = (DRAMAddr *) malloc(sizeof(DRAMAddr) * d_cap);
+	st->cells = (ReplayCell *) malloc(sizeof(ReplayCell) * c_cap);
+	offs = (size_t *) malloc(sizeof(size_t) * cap);
+
+	while (getline(&line, &l_cap, fp) != -1) {
+		line_n++;
+		if (line[0] == '#') {
+			parse_meta(line, &rounds, &d_cfg, &seed);
+			continue;
+		}
+		char *sep = strstr(line, " : ");
+		if (sep == NULL)
+			continue;
+		*sep = '\0';
+
+		ReplayPattern rp;
+		memset(&rp, 0x00, sizeof(rp));
+		rp.h_patt.rounds = rounds;
+		rp.d_cfg = d_cfg;
+		rp.seed = seed;
+		rp.r_min = UINT64_MAX;
+		rp.c_off = st->c_len;
+
+		size_t d_start = st->d_len;
+		char *save, *tok;
+		bool bad = false;
+		for (tok = strtok_r(line, "/", &save); tok != NULL;
+		     tok = strtok_r(NULL, "/", &save)) {
+			DRAMAddr d_addr;
+			memset(&d_addr, 0x00, sizeof(d_addr));
+			if (sscanf(tok, "r%lu.bk%lu", &d_addr.row, &d_addr.bank) != 2) {
+				bad = true;
+				break;
+			}
+			if (st->d_len == d_cap) {
+				d_cap *= 2;
+				st->d_arena = (DRAMAddr *) realloc(st->d_arena,
+								   sizeof(DRAMAddr) * d_cap);
+			}
+			st->d_arena[st->d_len++] = d_addr;
+			rp.r_min = d_addr.row < rp.r_min ? d_addr.row : rp.r_min;
+			rp.r_max = d_addr.row > rp.r_max ? d_addr.row : rp.r_max;
+		}
+		rp.h_patt.len = st->d_len - d_start;
+
+		for (tok = strtok_r(sep + 3, " \n", &save); tok != NULL && !bad;
+		     tok = strtok_r(NULL, " \n", &save)) {
+			DRAMAddr d_vict;
+			uint8_t f_og, f_new;
+			memset(&d_vict, 0x00, sizeof(d_vict));
+			if (sscanf(tok, "%hhx,%hhx,r%lu.bk%lu.col%lu", &f_og, &f_new,
+				   &d_vict.row, &d_vict.bank, &d_vict.col) != 5) {
+				bad = true;
+				break;
+			}
+			add_cells(st, &c_cap, d_vict, f_og, f_new);
+		}
+		rp.c_len = st->c_len - rp.c_off;
+
+		if (bad || rp.h_patt.len == 0) {
+			fprintf(stderr, "[WARN] - %s:%ld: not a fliptable line, skipped\n",
+				f_name, line_n);
+		}
+		if (bad || rp.h_patt.len == 0 || rp.c_len == 0) {
+			st->d_len = d_start;
+			st->c_len = rp.c_off;
+			continue;
+		}
+
+		if (st->len == cap) {
+			cap *= 2;
+			st->lst = (ReplayPattern *) realloc(st->lst, sizeof(ReplayPattern) * cap);
+			offs = (size_t *) realloc(offs, sizeof(size_t) * cap);
+		}
+		offs[st->len] = d_start;
+		st->lst[st->len++] = rp;
+	}
+	fclose(fp);
+	free(line);
+
+	for (size_t i = 0; i < st->len; i++) {
+		st->lst[i].h_patt.d_lst = st->d_arena + offs[i];
+	}
+	free(offs);
+	return 0;
+}
+
+void free_replay(ReplayState * st)
+{
+	free(st->lst);
+	free(st->d_arena);
+	free(st->cells);
+}
+
+// patterns sharing a seed, data pattern and window are hammered back to back
+static int cmp_replay(const void *a, const void *b)
+{
+	const ReplayPattern *ra = (const ReplayPattern *)a;
+	const ReplayPattern *rb = (const ReplayPattern *)b;
+
+	if (ra->seed != rb->seed)
+		return ra->seed < rb->seed ? -1 : 1;
+	if (ra->d_cfg != rb->d_cfg)
+		return ra->d_cfg < rb->d_cfg ? -1 : 1;
+	if (ra->r_min != rb->r_min)
+		return ra->r_min < rb->r_min ? -1 : 1;
+	return 0;
+}
+
+static void on_replay_flip(void *self, FlipVal * flip)
+{
+	HammerSuite *suite = (HammerSuite *) self;
+	ReplayState *st = (ReplayState *) suite->priv;
+	ReplayPattern *rp = st->cur;
+	uint8_t diff = flip->f_og ^ flip->f_new;
+	bool known = false;
+
+	for (int b = 0; b < 8; b++) {
+		if (!(diff & BIT_SET(b)))
+			continue;
+		ReplayCell *cell = NULL;
+		for (size_t i = rp->c_off; i < rp->c_off + rp->c_len; i++) {
+			ReplayCell *c = &st->cells[i];
+			if (c->row == flip->d_vict.row && c->bank == flip->d_vict.bank
+			    && c->col == flip->d_vict.col && c->bit == b) {
+				cell = c;
+				break;
+			}
+		}
+		if (cell == NULL) {
+			rp->fresh++;
+			continue;
+		}
+		known = true;
+		if (cell->last != st->rep) {
+			cell->last = st->rep;
+			cell->hits++;
+		}
+	}
+	if (known && rp->last != st->rep) {
+		rp->last = st->rep;
+		rp->hits++;
+	}
+}
+
+static void export_replay(ReplayState * st, size_t reps)
+{
+	for (size_t i = 0; i < st->len; i++) {
+		ReplayPattern *rp = &st->lst[i];
+		fprintf(out_fd,
+			"# pattern { patt: %s, h_rounds: %ld, d_cfg: %s, reps: %ld, hits: %ld, cells: %ld, fresh: %ld }\n",
+			hPatt_2_str(&rp->h_patt, ROW_FIELD | BK_FIELD), rp->h_patt.rounds,
+			data_str[rp->d_cfg], reps, rp->hits, rp->c_len, rp->fresh);
+		for (size_t j = rp->c_off; j < rp->c_off + rp->c_len; j++) {
+			ReplayCell *cell = &st->cells[j];
+			DRAMAddr d_cell = {.bank = cell->bank,.row = cell->row,.col = cell->col };
+			fprintf(out_fd, "# cell { cell: %s, bit: %d, f_og: %d, reps: %ld, hits: %ld }\n",
+				dAddr_2_str(d_cell, ALL_FIELDS), cell->bit, cell->f_og, reps,
+				cell->hits);
+		}
+	}
+	fflush(out_fd);
+}
+
+/*
+ Re-hammers every flip-producing pattern of p->replay_file p->replay_n
+ times and reports how often each pattern and each cell flips again.
+ The chunk is only refilled when the seed, data pattern or mapped window
+ changes, so a rep over N patterns costs N hammer/scan rounds.
+ */
+void replay_session(SessionConfig * cfg, MemoryBuffer * mem)
+{
+	ReplayState st;
+
+	DRAMAddr d_first = phys_2_dram(virt_2_phys(mem->buffer, mem));
+	uint64_t first = d_first.row;
+	uint64_t n_rows = mem->size / (ROW_SIZE * get_banks_cnt());
+	if (cfg->h_rows > n_rows)
+		cfg->h_rows = n_rows;
+
+	if (load_replay(p->replay_file, &st))
+		exit(1);
+
+	// victims of every pattern must be mapped too, the cells of the
+	// skipped ones go as well so they don't count as never flipped again
+	size_t keep = 0, c_keep = 0;
+	for (size_t i = 0; i < st.len; i++) {
+		ReplayPattern *rp = &st.lst[i];
+		if (rp->r_min < first + 1 || rp->r_max + 1 >= first + n_rows
+		    || rp->r_max - rp->r_min + 3 > cfg->h_rows) {
+			fprintf(stderr, "[WARN] - %s is not in the buffer, skipped\n",
+				hPatt_2_str(&rp->h_patt, ROW_FIELD | BK_FIELD));
+			continue;
+		}
+		memmove(&st.cells[c_keep], &st.cells[rp->c_off], sizeof(ReplayCell) * rp->c_len);
+		rp->c_off = c_keep;
+		c_keep += rp->c_len;
+		st.lst[keep++] = *rp;
+	}
+	st.len = keep;
+	st.c_len = c_keep;
+	if (st.len == 0) {
+		fprintf(stderr, "[ERROR] - Nothing to replay in %s\n", p->replay_file);
+		exit(1);
+	}
+	qsort(st.lst, st.len, sizeof(ReplayPattern), cmp_replay);
+
+	HammerSuite *suite = new_suite(cfg, mem, d_first);
+	suite->d_base.col = 0;
+	suite->on_flip = on_replay_flip;
+	suite->priv = &st;
+	suite->mapper = (ADDRMapper *) malloc(sizeof(ADDRMapper));
+
+	create_dir(DATA_DIR);
+	char *out_name = (char *)malloc(500);
+	sprintf(out_name, "%s%s.replay.%08ld.%d.%s.csv", DATA_DIR, p->g_out_prefix,
+		first, p->replay_n, REFRESH_VAL);
+	open_out_file(out_name, cfg);
+
+	fprintf(stderr, "[LOG] - Replay session! %ld patterns, %ld cells from %s, %d reps\n",
+		st.len, st.c_len, p->replay_file, p->replay_n);
+	fprintf(stderr, "[LOG] - File: %s\n", out_name);
+
+	for (st.rep = 1; st.rep <= (size_t)p->replay_n; st.rep++) {
+		bool mapped = false;
+		uint64_t seed = get_cl_seed();
+		int d_cfg = -1;
+		uint64_t time = 0;
+
+		for (size_t i = 0; i < st.len; i++) {
+			ReplayPattern *rp = &st.lst[i];
+			bool refill = false;
+
+			if (!mapped || rp->r_min - 1 < suite->d_base.row
+			    || rp->r_max + 1 >= suite->d_base.row + cfg->h_rows) {
+				if (mapped)
+					tear_down_addr_mapper(suite->mapper);
+				suite->d_base.row = rp->r_min - 1;
+				if (suite->d_base.row + cfg->h_rows > first + n_rows)
+					suite->d_base.row = first + n_rows - cfg->h_rows;
+				init_addr_mapper(suite->mapper, mem, &suite->d_base, cfg->h_rows);
+				mapped = true;
+				refill = true;
+			}
+			if (rp->seed != seed) {
+				seed = rp->seed;
+				set_cl_seed(seed);
+				fprintf(out_fd, "# { seed: 0x%lx }\n", seed);
+				refill = true;
+			}
+			if ((int)rp->d_cfg != d_cfg) {
+				d_cfg = rp->d_cfg;
+				cfg->d_cfg = rp->d_cfg;
+				refill = true;
+			}
+			if (refill)
+				init_chunk(suite);
+
+			st.cur = rp;
+			time += hammer_pattern(suite, &rp->h_patt);
+		}
+		if (mapped)
+			tear_down_addr_mapper(suite->mapper);
+
+		size_t hit = 0;
+		for (size_t i = 0; i < st.len; i++)
+			hit += st.lst[i].last == st.rep;
+		fprintf(stderr, "[REPLAY] - rep %ld: %ld/%ld patterns flipped again (%ld ms)\n",
+			st.rep, hit, st.len, time);
+	}
+
+	export_replay(&st, p->replay_n);
+
+	size_t all = 0, any = 0, c_hits = 0;
+	for (size_t i = 0; i < st.len; i++) {
+		all += st.lst[i].hits == (size_t)p->replay_n;
+		any += st.lst[i].hits > 0;
+	}
+	for (size_t i = 0; i < st.c_len; i++)
+		c_hits += st.cells[i].hits;
+	fprintf(stderr,
+		"[LOG] - Replay over: %ld/%ld patterns flipped every rep, %ld at least once, cell repeatability %.2f%%\n",
+		all, st.len, any, 100.0 * c_hits / (st.c_len * p->replay_n));
+
+	fclose(out_fd);
+	free_replay(&st);
+	free(suite->mapper);
+	free(suite);
+	free(out_name);
+}
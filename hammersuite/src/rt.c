@@ -0,0 +1,97 @@
+#include "rt.h"
+
+#include "hammer-suite.h"
+#include "params.h"
+#include "placement.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern ProfileParams *p;
+
+static RTStats stats;
+static pid_t locked = 0;	// mlockall() is not inherited by fleet workers
+static bool fifo_ok = true;
+
+void init_rt()
+{
+	Placement *pl = get_placement();
+
+	// the last core of the node, fleet workers are handed out from the first
+	if (pl->hammer_cpu == -1 && pl->cpu_cnt > 0) {
+		int cpu = pl->cpus[pl->cpu_cnt - 1];
+		if (pin_to_cpu(cpu) == 0) {
+			pl->hammer_cpu = cpu;
+			pl->scan_cpu = cpu;
+		}
+	}
+	if (p->fleet > 1 && p->fleet >= pl->cpu_cnt)
+		fprintf(stderr, "[WARN] - %d workers on %d cores, real-time windows will share cores\n",
+			p->fleet, pl->cpu_cnt);
+	fprintf(stderr, "[LOG] - Real-time windows: SCHED_FIFO %d on cpu %d\n", p->rt,
+		pl->hammer_cpu);
+}
+
+void rt_enter(RTWindow * w)
+{
+	if (locked != getpid()) {
+		locked = getpid();
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
+			perror("[WARN] - mlockall() failed");
+	}
+	if (fifo_ok) {
+		struct sched_param sp = {.sched_priority = p->rt };
+		if (sched_setscheduler(0, SCHED_FIFO, &sp) == -1) {
+			perror("[WARN] - SCHED_FIFO not available, windows are only measured");
+			fifo_ok = false;
+		}
+	}
+	w->max_gap = 0;
+	w->ticks = 0;
+	w->ns0 = realtime_now();
+	w->t0 = w->last = rdtsc();
+}
+
+// back to SCHED_OTHER for the scans, a FIFO task never gives the core back
+void rt_leave(RTWindow * w)
+{
+	uint64_t cycles = rdtsc() - w->t0;
+	uint64_t ns = realtime_now() - w->ns0;
+
+	if (fifo_ok) {
+		struct sched_param sp = {.sched_priority = 0 };
+		sched_setscheduler(0, SCHED_OTHER, &sp);
+	}
+
+	uint64_t gap_ns = cycles ? (double)w->max_gap * ns / cycles : 0;
+	uint64_t avg_ns = w->ticks ? ns / w->ticks : 0;
+	stats.windows++;
+	stats.gap_acc_ns += gap_ns;
+	if (gap_ns > stats.max_gap_ns)
+		stats.max_gap_ns = gap_ns;
+	if (gap_ns > avg_ns + RT_GAP_ns) {
+		stats.disturbed++;
+		if (p->g_flags & F_VERBOSE)
+			fprintf(stderr, "[WARN] - Hammer window disturbed: %.1f us round (avg %.1f us)\n",
+				gap_ns / 1e3, avg_ns / 1e3);
+	}
+}
+
+RTStats *get_rt_stats()
+{
+	return &stats;
+}
+
+void export_rt_stats()
+{
+	if (!p->rt || out_fd == NULL)
+		return;
+	uint64_t avg = stats.windows ? stats.gap_acc_ns / stats.windows : 0;
+	fprintf(stderr, "[LOG] - Real-time windows: %ld/%ld disturbed, max gap %.1f us, avg max gap %.1f us\n",
+		stats.disturbed, stats.windows, stats.max_gap_ns / 1e3, avg / 1e3);
+	fprintf(out_fd, "# { rt_windows: %ld, disturbed: %ld, max_gap_ns: %ld, avg_max_gap_ns: %ld }\n",
+		stats.windows, stats.disturbed, stats.max_gap_ns, avg);
+	fflush(out_fd);
+}
@@ -0,0 +1,339 @@
+#include "sweep.h"
+
+#include "hammer-suite.h"
+#include "pattern-spec.h"
+#include "fleet.h"
+#include "conflict.h"
+#include "rt.h"
+#include "perf.h"
+#include "dram-address.h"
+#include "addr-mapper.h"
+#include "memory.h"
+#include "params.h"
+#include "utils.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern ProfileParams *p;
+
+static uint64_t bit_idx(SweepIndex * idx, uint64_t row, uint64_t bank,
+			uint64_t patt)
+{
+	return (row * idx->hdr->banks + bank) * idx->hdr->patts + patt;
+}
+
+int open_sweep_index(const char *f_name, SweepIndex * idx, uint64_t patts)
+{
+	DRAMLayout *layout = get_dram_layout();
+	uint64_t rows = (layout->row_mask >> __builtin_ctzl(layout->row_mask)) + 1;
+	uint64_t n_bits = rows * get_banks_cnt() * patts;
+	struct stat st;
+
+	idx->size = sizeof(SweepHeader) + ((n_bits + 63) / 64) * sizeof(uint64_t);
+	if ((idx->fd = open(f_name, O_CREAT | O_RDWR, 0644)) == -1) {
+		perror("[ERROR] - Unable to open sweep index");
+		return -1;
+	}
+	fstat(idx->fd, &st);
+	bool fresh = st.st_size == 0;
+	if (fresh && ftruncate(idx->fd, idx->size) == -1) {
+		perror("[ERROR] - Unable to size sweep index");
+		close(idx->fd);
+		return -1;
+	}
+	if (!fresh && (size_t)st.st_size != idx->size) {
+		fprintf(stderr, "[ERROR] - %s doesn't match this layout/pattern set\n",
+			f_name);
+		close(idx->fd);
+		return -1;
+	}
+
+	idx->hdr = (SweepHeader *) mmap(NULL, idx->size, PROT_READ | PROT_WRITE,
+					MAP_SHARED, idx->fd, 0);
+	if (idx->hdr == MAP_FAILED) {
+		perror("[ERROR] - mmap() of sweep index failed");
+		close(idx->fd);
+		return -1;
+	}
+	idx->bits = (uint64_t *) (idx->hdr + 1);
+
+	if (fresh) {
+		idx->hdr->magic = SWEEP_MAGIC;
+		idx->hdr->rows = rows;
+		idx->hdr->banks = get_banks_cnt();
+		idx->hdr->patts = patts;
+		idx->hdr->done = 0;
+	} else if (idx->hdr->magic != SWEEP_MAGIC || idx->hdr->rows != rows
+		   || idx->hdr->banks != get_banks_cnt()
+		   || idx->hdr->patts != patts) {
+		fprintf(stderr, "[ERROR] - %s doesn't match this layout/pattern set\n",
+			f_name);
+		close_sweep_index(idx);
+		return -1;
+	}
+	return 0;
+}
+
+bool sweep_done(SweepIndex * idx, uint64_t row, uint64_t bank, uint64_t patt)
+{
+	uint64_t bit = bit_idx(idx, row, bank, patt);
+	return (__atomic_load_n(&idx->bits[bit / 64], __ATOMIC_RELAXED) >> (bit % 64)) & 1;
+}
+
+// the index may be shared by several shards, hence the atomics
+void sweep_mark(SweepIndex * idx, uint64_t row, uint64_t bank, uint64_t patt)
+{
+	uint64_t bit = bit_idx(idx, row, bank, patt);
+	uint64_t old = __atomic_fetch_or(&idx->bits[bit / 64], BIT_SET(bit % 64),
+					 __ATOMIC_RELAXED);
+	if (!((old >> (bit % 64)) & 1))
+		__atomic_fetch_add(&idx->hdr->done, 1, __ATOMIC_RELAXED);
+}
+
+void close_sweep_index(SweepIndex * idx)
+{
+	msync(idx->hdr, idx->size, MS_SYNC);
+	munmap(idx->hdr, idx->size);
+	close(idx->fd);
+}
+
+// patterns are moved so that their lowest aggressor is at row 0
+static size_t normalize_spec(PatternSpec * spec)
+{
+	size_t extent = 0;
+	for (size_t i = 0; i < spec->len; i++) {
+		HammerPattern *h_patt = &spec->lst[i].h_patt;
+		uint64_t r_min = UINT64_MAX, r_max = 0;
+		for (size_t j = 0; j < h_patt->len; j++) {
+			r_min = h_patt->d_lst[j].row < r_min ? h_patt->d_lst[j].row : r_min;
+			r_max = h_patt->d_lst[j].row > r_max ? h_patt->d_lst[j].row : r_max;
+		}
+		for (size_t j = 0; j < h_patt->len; j++)
+			h_patt->d_lst[j].row -= r_min;
+		extent = r_max - r_min > extent ? r_max - r_min : extent;
+	}
+	return extent;
+}
+
+// default pattern set: n-sided with --aggr aggressors, like n_sided_test()
+static void default_spec(PatternSpec * spec, SessionConfig * cfg)
+{
+	spec->len = 1;
+	spec->d_len = cfg->aggr_n;
+	spec->lst = (SpecEntry *) malloc(sizeof(SpecEntry));
+	spec->d_arena = (DRAMAddr *) calloc(cfg->aggr_n, sizeof(DRAMAddr));
+	for (int i = 0; i < cfg->aggr_n; i++)
+		spec->d_arena[i].row = 2 * i;
+	spec->lst[0].h_patt.d_lst = spec->d_arena;
+	spec->lst[0].h_patt.len = cfg->aggr_n;
+	spec->lst[0].h_patt.rounds = cfg->h_rounds;
+	spec->lst[0].d_cfg = cfg->d_cfg;
+	spec->lst[0].banks = ~0ULL;
+	spec->lst[0].spread = p->spread;
+}
+
+typedef struct {
+	HammerSuite *suite;
+	PatternSpec spec;
+	SweepIndex idx;
+	HammerPattern h_patt;
+	uint64_t first;
+	uint64_t n_rows;
+	size_t extent;
+	uint64_t stride;
+	uint64_t *wins;		// windows of this shard
+	size_t w_cnt;
+} SweepCtx;
+
+// hammers the target rows of window w on the banks of the suite
+static void sweep_window(SweepCtx * ctx, uint64_t w)
+{
+	HammerSuite *suite = ctx->suite;
+	SessionConfig *cfg = suite->cfg;
+	HammerPattern *h_patt = &ctx->h_patt;
+	PatternSpec *spec = &ctx->spec;
+	uint64_t first = ctx->first, n_rows = ctx->n_rows;
+
+	// target rows, leaving room for the victims on both sides
+	uint64_t lo = w > first + 1 ? w : first + 1;
+	uint64_t hi = w + ctx->stride;
+	if (hi + ctx->extent + 1 > first + n_rows)
+		hi = first + n_rows - ctx->extent - 1;
+	if (lo >= hi)
+		return;
+
+	size_t todo = 0;
+	for (uint64_t row = lo; row < hi; row++)
+		for (size_t bk = 0; bk < get_banks_cnt(); bk++)
+			for (size_t pi = 0; pi < spec->len; pi++)
+				todo += (spec->lst[pi].banks & suite->banks & BIT_SET(bk))
+				    && !sweep_done(&ctx->idx, row, bk, pi);
+	if (todo == 0)
+		return;
+
+	uint64_t start = lo - 1;
+	if (start + cfg->h_rows > first + n_rows)
+		start = first + n_rows - cfg->h_rows;
+	suite->d_base.row = start;
+	init_addr_mapper(suite->mapper, suite->mem, &suite->d_base, cfg->h_rows);
+
+	fprintf(stderr, "[SWEEP] - rows %ld-%ld: %ld tuples left\n", lo, hi - 1, todo);
+	for (size_t pi = 0; pi < spec->len; pi++) {
+		SpecEntry *entry = &spec->lst[pi];
+		cfg->d_cfg = entry->d_cfg;
+		init_chunk(suite);
+
+		h_patt->len = entry->h_patt.len;
+		h_patt->rounds = entry->h_patt.rounds;
+		for (uint64_t row = lo; row < hi; row++) {
+			for (size_t bk = 0; bk < get_banks_cnt(); bk++) {
+				if (!(entry->banks & suite->banks & BIT_SET(bk)))
+					continue;
+				if (sweep_done(&ctx->idx, row, bk, pi))
+					continue;
+				for (size_t j = 0; j < h_patt->len; j++) {
+					h_patt->d_lst[j] = entry->h_patt.d_lst[j];
+					h_patt->d_lst[j].row += row;
+					h_patt->d_lst[j].col = 0;
+				}
+				spread_banks(h_patt, bk, entry->spread);
+				hammer_pattern(suite, h_patt);
+				sweep_mark(&ctx->idx, row, bk, pi);
+			}
+		}
+	}
+	tear_down_addr_mapper(suite->mapper);
+	msync(ctx->idx.hdr, ctx->idx.size, MS_ASYNC);
+}
+
+static void export_sweep_stats()
+{
+	export_scan_stats();
+	export_conflict_stats();
+	export_rt_stats();
+	export_perf_stats();
+}
+
+/*
+ Fleet job: every worker walks all the windows, each on its own banks.
+ The counters live in the worker's address space, so it writes them to
+ its own file after the last window and they are merged with it.
+ */
+static void sweep_job(int worker, uint64_t job, void *arg)
+{
+	SweepCtx *ctx = (SweepCtx *) arg;
+
+	ctx->suite->banks = fleet_worker_banks(worker);
+	ctx->suite->on_flip = fleet_on_flip;
+	sweep_window(ctx, ctx->wins[job]);
+	if (job == ctx->w_cnt - 1)
+		export_sweep_stats();
+}
+
+/*
+ Walks every row of every bank reachable in the buffer. Target rows are
+ grouped in windows of (h_rows - extent - 2) rows, each hammered with its
+ own mapper/chunk so that aggressors and victims always fit. Windows are
+ numbered from DRAM row 0 and dealt round-robin to the shards. With
+ --fleet every worker sweeps all the windows of the shard on its share of
+ the banks; the index is per bank, so a window is only skipped on resume
+ for the banks whose worker finished it.
+ */
+void sweep_session(SessionConfig * cfg, MemoryBuffer * mem)
+{
+	SweepCtx ctx;
+
+	DRAMAddr d_first = phys_2_dram(virt_2_phys(mem->buffer, mem));
+	ctx.first = d_first.row;
+	ctx.n_rows = mem->size / (ROW_SIZE * get_banks_cnt());
+	if (cfg->h_rows > ctx.n_rows)
+		cfg->h_rows = ctx.n_rows;
+
+	HammerSuite *suite = new_suite(cfg, mem, d_first);
+	suite->d_base.row = 0;
+	suite->d_base.col = 0;
+	ctx.suite = suite;
+
+	if (p->patt_file != NULL) {
+		if (load_pattern_spec(p->patt_file, &ctx.spec, suite))
+			exit(1);
+	} else {
+		default_spec(&ctx.spec, cfg);
+	}
+	ctx.extent = normalize_spec(&ctx.spec);
+	if (ctx.extent + 3 > cfg->h_rows) {
+		fprintf(stderr, "[ERROR] - Patterns span %ld rows, window is %ld\n",
+			ctx.extent + 1, cfg->h_rows);
+		exit(1);
+	}
+	ctx.stride = cfg->h_rows - ctx.extent - 2;
+
+	char *idx_name = (char *)malloc(500);
+	create_dir(DATA_DIR);
+	if (p->sweep_file != NULL) {
+		strcpy(idx_name, p->sweep_file);
+	} else {
+		sprintf(idx_name, "%s%s.sweep.idx", DATA_DIR, p->g_out_prefix);
+	}
+	if (open_sweep_index(idx_name, &ctx.idx, ctx.spec.len))
+		exit(1);
+
+	char *out_name = (char *)malloc(500);
+	sprintf(out_name, "%s%s.sweep.%02d-%02d.%08ld.%ld.%s.csv", DATA_DIR,
+		p->g_out_prefix, p->shard_i, p->shard_n, ctx.first, cfg->h_rounds,
+		REFRESH_VAL);
+	open_out_file(out_name, cfg);
+
+	fprintf(stderr,
+		"[LOG] - Sweep session! rows %ld-%ld, %ld patterns, shard %d/%d\n",
+		ctx.first, ctx.first + ctx.n_rows - 1, ctx.spec.len, p->shard_i, p->shard_n);
+	fprintf(stderr, "[LOG] - Index: %s (%ld tuples done)\n", idx_name,
+		ctx.idx.hdr->done);
+	fprintf(stderr, "[LOG] - File: %s\n", out_name);
+
+	ctx.h_patt.d_lst = (DRAMAddr *) malloc(sizeof(DRAMAddr) * PATT_LEN);
+	suite->mapper = (ADDRMapper *) malloc(sizeof(ADDRMapper));
+
+	ctx.wins = (uint64_t *) malloc(sizeof(uint64_t) * (ctx.n_rows / ctx.stride + 2));
+	ctx.w_cnt = 0;
+	for (uint64_t w = ctx.first / ctx.stride * ctx.stride; w < ctx.first + ctx.n_rows;
+	     w += ctx.stride) {
+		if ((w / ctx.stride) % p->shard_n == (uint64_t) p->shard_i)
+			ctx.wins[ctx.w_cnt++] = w;
+	}
+
+	if (p->fleet > (int)get_banks_cnt())
+		p->fleet = get_banks_cnt();
+	for (size_t i = 0; p->fleet > 1 && i < ctx.spec.len; i++) {
+		if (ctx.spec.lst[i].spread > 1) {
+			fprintf(stderr, "[ERROR] - Cross-bank patterns can't be split between fleet workers\n");
+			exit(1);
+		}
+	}
+	if (p->fleet > 1) {
+		fleet_run(ctx.w_cnt, sweep_job, &ctx, out_name);
+	} else {
+		for (size_t i = 0; i < ctx.w_cnt; i++)
+			sweep_window(&ctx, ctx.wins[i]);
+	}
+
+	fprintf(stderr, "[LOG] - Sweep over, %ld tuples done overall\n", ctx.idx.hdr->done);
+	if (p->fleet <= 1)
+		export_sweep_stats();
+	fclose(out_fd);
+	close_sweep_index(&ctx.idx);
+	free_pattern_spec(&ctx.spec);
+	free(ctx.h_patt.d_lst);
+	free(ctx.wins);
+	free(suite->mapper);
+	free(suite);
+	free(out_name);
+	free(idx_name);
+}
@@ -0,0 +1,85 @@
+#include "trace.h"
+
+#include "fleet.h"
+#include "params.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+extern ProfileParams *p;
+
+Trace g_trace = {.ring = NULL,.head = 0,.last = 0,.t0 = 0,.ns0 = 0,.seq = 0,.fp = NULL,.pid = 0 };
+
+// fleet workers write their own trace, the coordinator does not merge them
+static FILE *open_trace()
+{
+	char f_name[600];
+
+	create_dir(DATA_DIR);
+	if (fleet_worker_id() == -1)
+		sprintf(f_name, "%s%s.trace", DATA_DIR, p->g_out_prefix);
+	else
+		sprintf(f_name, "%s%s.trace.w%02d", DATA_DIR, p->g_out_prefix, fleet_worker_id());
+	FILE *fp = fopen(f_name, "wb");
+	if (fp == NULL) {
+		perror("[ERROR] - Unable to open trace file");
+		exit(1);
+	}
+	fprintf(stderr, "[LOG] - Tracing every %d rounds to %s\n", p->trace, f_name);
+	return fp;
+}
+
+void trace_begin()
+{
+	if (g_trace.ring == NULL)
+		g_trace.ring = (uint32_t *) malloc(sizeof(uint32_t) * TRACE_CAP);
+	g_trace.head = 0;
+	g_trace.ns0 = realtime_now();
+	g_trace.t0 = g_trace.last = rdtscp();
+}
+
+void trace_end(HammerPattern * h_patt, size_t rounds)
+{
+	TraceRecord rec;
+	uint64_t now = rdtscp();
+
+	if (g_trace.fp == NULL || g_trace.pid != getpid()) {
+		g_trace.fp = open_trace();
+		g_trace.pid = getpid();
+		g_trace.seq = 0;
+	}
+
+	rec.magic = TRACE_MAGIC;
+	rec.seq = g_trace.seq++;
+	rec.k = p->trace;
+	rec.rounds = rounds;
+	rec.len = h_patt->len;
+	rec.samples = g_trace.head < TRACE_CAP ? g_trace.head : TRACE_CAP;
+	rec.dropped = g_trace.head - rec.samples;
+	rec.cycles = now - g_trace.t0;
+	rec.ns = realtime_now() - g_trace.ns0;
+	fwrite(&rec, sizeof(TraceRecord), 1, g_trace.fp);
+
+	for (size_t i = 0; i < h_patt->len; i++) {
+		uint64_t aggr = (h_patt->d_lst[i].bank << 32) | h_patt->d_lst[i].row;
+		fwrite(&aggr, sizeof(uint64_t), 1, g_trace.fp);
+	}
+	// oldest first, the ring may have wrapped
+	uint64_t first = g_trace.head - rec.samples;
+	uint64_t off = first & (TRACE_CAP - 1);
+	size_t tail = rec.samples < TRACE_CAP - off ? rec.samples : TRACE_CAP - off;
+	fwrite(g_trace.ring + off, sizeof(uint32_t), tail, g_trace.fp);
+	fwrite(g_trace.ring, sizeof(uint32_t), rec.samples - tail, g_trace.fp);
+	// workers leave with _exit()
+	fflush(g_trace.fp);
+}
+
+void close_trace()
+{
+	if (g_trace.fp != NULL && g_trace.pid == getpid())
+		fclose(g_trace.fp);
+	free(g_trace.ring);
+	g_trace.fp = NULL;
+	g_trace.ring = NULL;
+}
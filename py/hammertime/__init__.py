@@ -1,3 +1,3 @@
 #!/usr/bin/env python3
 # -*- coding: UTF-8 -*-
-__all__ = ['sim', 'fliptable', 'dramtrans']
+__all__ = ['sim', 'fliptable', 'dramtrans', 'hammerd', 'celldb', 'trace', 'metrics', 'flipstream']
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+# -*- coding: UTF-8 -*-
+# Copyright (c) 2018 Vrije Universiteit Amsterdam
+#
+# This program is licensed under the GPL2+.
+
+"""Reader for the vulnerable cell db written by `tester --celldb`."""
+
+import ctypes
+import mmap
+
+from hammertime.dramtrans import DRAMAddr
+
+MAGIC = 0x74727263656c6c32
+PULLDN = 1 << 0
+PULLUP = 1 << 1
+
+
+class Header(ctypes.Structure):
+    _fields_ = [('magic', ctypes.c_uint64),
+                ('slots', ctypes.c_uint64),
+                ('cells', ctypes.c_uint64),
+                ('p_cap', ctypes.c_uint64),
+                ('p_len', ctypes.c_uint64),
+                ('rows', ctypes.c_uint64),
+                ('banks', ctypes.c_uint64),
+                ('unindexed', ctypes.c_uint64)]
+
+
+class Slot(ctypes.Structure):
+    _fields_ = [('key', ctypes.c_uint64),
+                ('hits', ctypes.c_uint32),
+                ('dirs', ctypes.c_uint8),
+                ('pad', ctypes.c_uint8 * 3),
+                ('first', ctypes.c_uint64),
+                ('last', ctypes.c_uint64),
+                ('p_first', ctypes.c_uint64),
+                ('p_last', ctypes.c_uint64),
+                ('patts', ctypes.c_uint64),
+                ('next', ctypes.c_uint64)]
+
+    @property
+    def bank(self):
+        return (self.key >> 48) & 0x7fff
+
+    @property
+    def row(self):
+        return (self.key >> 16) & 0xffffffff
+
+    @property
+    def col(self):
+        return (self.key >> 3) & 0x1fff
+
+    @property
+    def bit(self):
+        return self.key & 0x7
+
+    @property
+    def addr(self):
+        return DRAMAddr(self.bank, self.row, self.col)
+
+    def __str__(self):
+        return '{0.addr}.{0.bit}|{0.hits}|{0.dirs}'.format(self)
+
+    def __repr__(self):
+        return self.__str__()
+
+
+def _hash(key):
+    # same as hash_key() in celldb.c
+    key ^= key >> 33
+    key = (key * 0xff51afd7ed558ccd) & 0xffffffffffffffff
+    return key ^ (key >> 33)
+
+
+class CellDB:
+    """
+    Read-only view of a cell db. The file is mapped, not parsed, so opening
+    it is cheap whatever the number of cells, and a running tester keeps
+    updating it underneath.
+    """
+
+    def __init__(self, path):
+        self.f = open(path, 'rb')
+        self.mm = mmap.mmap(self.f.fileno(), 0, access=mmap.ACCESS_READ)
+        self.hdr = Header.from_buffer_copy(self.mm)
+        if self.hdr.magic != MAGIC:
+            raise ValueError('{} is not a cell db'.format(path))
+        self.s_off = ctypes.sizeof(Header)
+        self.r_off = self.s_off + self.hdr.slots * ctypes.sizeof(Slot)
+        self.p_off = self.r_off + self.hdr.rows * 16
+        # slot keys only, 8 words per slot
+        self.keys = memoryview(self.mm)[self.s_off:self.r_off].cast('Q')[::8]
+        # (key, head) of every row
+        self.rows = memoryview(self.mm)[self.r_off:self.p_off].cast('Q')
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def close(self):
+        self.keys.release()
+        self.rows.release()
+        self.mm.close()
+        self.f.close()
+
+    def __len__(self):
+        return Header.from_buffer_copy(self.mm).cells
+
+    def __iter__(self):
+        size = ctypes.sizeof(Slot)
+        for i, key in enumerate(self.keys):
+            if key:
+                yield Slot.from_buffer_copy(self.mm, self.s_off + i * size)
+
+    def _slot(self, i):
+        return Slot.from_buffer_copy(self.mm, self.s_off + i * ctypes.sizeof(Slot))
+
+    def row(self, bank, row):
+        """Cells of one row, from the row table"""
+        key = (1 << 63) | (bank << 32) | row
+        mask = self.hdr.rows - 1
+        h = _hash(key) & mask
+        for _ in range(self.hdr.rows):
+            cur = self.rows[2 * h]
+            if cur == 0:
+                return
+            if cur == key:
+                i = self.rows[2 * h + 1]
+                while i:
+                    cell = self._slot(i - 1)
+                    yield cell
+                    i = cell.next
+                return
+            h = (h + 1) & mask
+
+    def query(self, bank=None, rows=None):
+        """Cells of `bank` (every bank if None) with a row in range `rows`"""
+        hdr = Header.from_buffer_copy(self.mm)
+        if rows is not None and hdr.unindexed == 0:
+            banks = range(hdr.banks) if bank is None else [bank]
+            if len(rows) * len(banks) <= hdr.rows:
+                for b in banks:
+                    for r in rows:
+                        yield from self.row(b, r)
+                return
+        for cell in self:
+            if bank is not None and cell.bank != bank:
+                continue
+            if rows is not None and cell.row not in rows:
+                continue
+            yield cell
+
+    def pattern(self, off):
+        """Aggressors of the pattern logged at `off`, as DRAMAddr"""
+        if off == 0:
+            return []
+        words = (ctypes.c_uint64 * 1).from_buffer_copy(self.mm, self.p_off + off * 8)
+        n = words[0]
+        lst = (ctypes.c_uint64 * n).from_buffer_copy(self.mm, self.p_off + (off + 1) * 8)
+        return [DRAMAddr(w >> 32, w & 0xffffffff, 0) for w in lst]
@@ -9,6 +9,8 @@ import functools
 
 
 HASH_FN_CNT = 6
+# DRAM dimension of every hash function, see DRAMDim in dram-address.h
+DIM_BK, DIM_BG, DIM_RK, DIM_CH = range(4)
 _native = None
 
 @functools.total_ordering
@@ -88,7 +90,8 @@ class _AddrFns(ctypes.Structure):
 class _DRAMLayout(ctypes.Structure):
     _fields_ = [("h_fns", _AddrFns),
                 ("row_mask", ctypes.c_uint64),
-                ("col_mask", ctypes.c_uint64)]
+                ("col_mask", ctypes.c_uint64),
+                ("h_dims", ctypes.c_uint64 * HASH_FN_CNT)]
 
     def __init__(self, upack):
         self.h_fns.lst = (ctypes.c_uint64*6) (*[0x2040,0x44000,0x88000,0x110000,0x220000,0x00]) 
@@ -99,6 +102,7 @@ class _DRAMLayout(ctypes.Structure):
 #        self.h_fns.len = upack[HASH_FN_CNT]
 #        self.row_mask = upack[HASH_FN_CNT+1]
 #        self.col_mask = upack[HASH_FN_CNT+2]
+#        self.h_dims = upack[HASH_FN_CNT+3:]
 
     @property
     def num_banks(self):
@@ -110,6 +114,19 @@ class _DRAMLayout(ctypes.Structure):
     def get_dram_row(self, p_addr): 
         return (p_addr & self.col_mask) >> _native.ctzl(self.col_mask)
 
+    def get_dram_dim(self, bank, dim):
+        """Bank bits of `bank` selected by the hash functions labeled `dim`"""
+        res, pos = 0, 0
+        for i in range(self.h_fns.len):
+            if self.h_dims[i] == dim:
+                res |= ((bank >> i) & 1) << pos
+                pos += 1
+        return res
+
+    def get_dram_coord(self, bank):
+        """(channel, rank, bank group, bank) of a flat bank index"""
+        return tuple(self.get_dram_dim(bank, d) for d in (DIM_CH, DIM_RK, DIM_BG, DIM_BK))
+
 
 class MemorySystem(ctypes.Structure):
     _fields_ = [('mem_layout', _DRAMLayout)]
@@ -121,7 +138,7 @@ class MemorySystem(ctypes.Structure):
         return super().__init__()
     
     def load(self, s):
-        DRAMLAyout_fmt = f"{HASH_FN_CNT}QQQQ"
+        DRAMLAyout_fmt = f"{HASH_FN_CNT}QQQQ{HASH_FN_CNT}Q"
         self.mem_layout = _DRAMLayout(struct.unpack(DRAMLAyout_fmt, s))
 
     def load_file(self, fname):
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+# -*- coding: UTF-8 -*-
+# Copyright (c) 2018 Vrije Universiteit Amsterdam
+#
+# This program is licensed under the GPL2+.
+
+"""Reader for the flip ring published by `tester --flip-stream`.
+
+usage: python3 -m hammertime.flipstream [NAME] [-i SECS]
+
+Maps /dev/shm/NAME (default: the newest /dev/shm/trrespass.flips.*)
+read-only and prints the flips as the scans find them.
+"""
+
+import ctypes
+import glob
+import mmap
+import os
+import sys
+import time
+
+from hammertime.dramtrans import DRAMAddr
+from hammertime.fliptable import Attack, Corruption
+
+MAGIC = 0x7472726669707321
+SHM_DIR = '/dev/shm/'
+PREFIX = 'trrespass.flips.'
+
+
+class Event(ctypes.Structure):
+    _fields_ = [('seq', ctypes.c_uint64),
+                ('patt', ctypes.c_uint64),
+                ('bank', ctypes.c_uint32),
+                ('row', ctypes.c_uint32),
+                ('col', ctypes.c_uint32),
+                ('exp', ctypes.c_uint8),
+                ('got', ctypes.c_uint8),
+                ('bits', ctypes.c_uint8),
+                ('up', ctypes.c_uint8)]
+
+    @property
+    def addr(self):
+        return DRAMAddr(self.bank, self.row, self.col)
+
+    def to_flips(self):
+        return Corruption(self.addr, self.got, self.exp).to_flips()
+
+    def __str__(self):
+        return 'p{0.patt} b{0.bank:02d}.r{0.row:06d}.c{0.col:04d} {0.exp:02x} => {0.got:02x}'.format(self)
+
+
+class Header(ctypes.Structure):
+    _fields_ = [('magic', ctypes.c_uint64),
+                ('pid', ctypes.c_int64),
+                ('cap', ctypes.c_uint64),
+                ('head', ctypes.c_uint64),
+                ('patterns', ctypes.c_uint64),
+                ('pad', ctypes.c_uint64 * 3)]
+
+
+EV_SIZE = ctypes.sizeof(Event)
+HDR_SIZE = ctypes.sizeof(Header)
+
+
+class FlipStream:
+    """Cursor on the flip ring of one run, any number of them can read it"""
+
+    def __init__(self, name=None, start=0):
+        if name is None:
+            names = sorted(glob.glob(SHM_DIR + PREFIX + '*'), key=os.path.getmtime)
+            if not names:
+                raise FileNotFoundError('No flip stream in {}'.format(SHM_DIR))
+            name = names[-1]
+        self.path = name if name.startswith('/dev/') else SHM_DIR + name.lstrip('/')
+        with open(self.path, 'rb') as f:
+            self.mm = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+        hdr = Header.from_buffer_copy(self.mm)
+        if hdr.magic != MAGIC:
+            raise ValueError('{}: not a flip stream'.format(self.path))
+        self.pid = hdr.pid
+        self.cap = hdr.cap
+        # events overwritten before we could read them
+        self.lost = 0
+        self.next = start if start >= 0 else max(0, self.head() + start)
+
+    def head(self):
+        return Header.from_buffer_copy(self.mm).head
+
+    def _slot(self, i):
+        return HDR_SIZE + (i % self.cap) * EV_SIZE
+
+    def poll(self):
+        """Every event published since the last call"""
+        out = []
+        while True:
+            off = self._slot(self.next)
+            ev = Event.from_buffer_copy(self.mm, off)
+            if ev.seq == 0 or ev.seq <= self.next:
+                # being written or not there yet
+                return out
+            if ev.seq > self.next + 1:
+                # lapped: skip to the oldest event still in the ring
+                first = max(self.next + 1, ev.seq - self.cap)
+                self.lost += first - self.next
+                self.next = first
+                continue
+            if Event.from_buffer_copy(self.mm, off).seq != ev.seq:
+                continue
+            out.append(ev)
+            self.next += 1
+
+    def alive(self):
+        try:
+            os.kill(self.pid, 0)
+        except ProcessLookupError:
+            return False
+        except PermissionError:
+            pass
+        return os.path.exists(self.path)
+
+    def follow(self, interval=0.1):
+        """Yields the events as they come, until the run exits"""
+        while True:
+            evs = self.poll()
+            yield from evs
+            if not evs:
+                if not self.alive():
+                    yield from self.poll()
+                    return
+                time.sleep(interval)
+
+    def attacks(self, interval=0.1):
+        """
+        Yields fliptable Attacks, one per pattern, without targets.
+
+        The flips of a pattern come in one burst from its scan: an attack
+        is complete once a poll brings no more flips for it.
+        """
+        open_atks = {}
+        while True:
+            evs = self.poll()
+            touched = set()
+            for ev in evs:
+                open_atks.setdefault(ev.patt, set()).update(ev.to_flips())
+                touched.add(ev.patt)
+            for patt in [k for k in open_atks if k not in touched]:
+                yield Attack(targets=(), flips=open_atks.pop(patt))
+            if not evs:
+                if not self.alive():
+                    for flips in open_atks.values():
+                        yield Attack(targets=(), flips=flips)
+                    return
+                time.sleep(interval)
+
+    def close(self):
+        self.mm.close()
+
+
+if __name__ == '__main__':
+    args = sys.argv[1:]
+    interval = 0.1
+    if '-i' in args:
+        i = args.index('-i')
+        interval = float(args[i + 1])
+        del args[i:i + 2]
+    try:
+        fs = FlipStream(args[0] if args else None)
+        for ev in fs.follow(interval):
+            print(ev)
+            sys.stdout.flush()
+        if fs.lost:
+            print('{} flips lost, the ring holds {}'.format(fs.lost, fs.cap), file=sys.stderr)
+    except KeyboardInterrupt:
+        pass
@@ -180,6 +180,9 @@ class Attack(namedtuple('Attack', ['targets', 'flips'])):
 def decode_lines(lineiter):
     curatk = None
     for line in lineiter:
+        # metadata (e.g. numa placement) is kept in comment lines
+        if line.startswith('#'):
+            continue
         atk = Attack.decode_line(line)
         if curatk is None:
             curatk = atk
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# -*- coding: UTF-8 -*-
+# Copyright (c) 2018 Vrije Universiteit Amsterdam
+#
+# This program is licensed under the GPL2+.
+
+"""Client for the hammer daemon (`tester --serve`)."""
+
+import socket
+
+from hammertime import fliptable
+
+DEFAULT_SOCK = '/tmp/trrespass.sock'
+
+
+class HammerError(Exception):
+    pass
+
+
+class HammerClient:
+    """
+    Sends hammer jobs to a running daemon and returns the resulting attacks.
+
+    The daemon keeps the buffer, physmap and DRAM mapper warm, so every job
+    only pays for filling, hammering and scanning its own rows.
+    """
+
+    def __init__(self, path=DEFAULT_SOCK):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.rfile = self.sock.makefile('r')
+        hello = self.rfile.readline()
+        self.info = {k: int(v) for k, v in fliptable.RE_DICT.findall(hello)}
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def close(self):
+        try:
+            self.sock.sendall(b'quit\n')
+        except OSError:
+            pass
+        self.rfile.close()
+        self.sock.close()
+
+    def shutdown(self):
+        """Stop the daemon once this connection is closed"""
+        self.sock.sendall(b'shutdown\n')
+        self.rfile.close()
+        self.sock.close()
+
+    def hammer(self, rows, bank=None, rounds=None, data=None, spread=None):
+        """
+        Hammer `rows` (relative to the daemon base row) on `bank`, or on every
+        bank if None. Returns one fliptable.Attack per bank hammered. With
+        `spread` the aggressors are split in runs of rows at most 2 apart
+        (they share a victim and stay in one bank) and the runs are spread
+        over that many banks; fewer runs than `spread` use fewer banks.
+        """
+        job = 'rows={}'.format(','.join(str(r) for r in rows))
+        job += ' banks={}'.format('all' if bank is None else bank)
+        if spread is not None:
+            job += ' spread={}'.format(spread)
+        if rounds is not None:
+            job += ' rounds={}'.format(rounds)
+        if data is not None:
+            job += ' data={}'.format(data)
+        self.sock.sendall((job + '\n').encode())
+
+        attacks = []
+        for line in self.rfile:
+            if line.startswith('# ok'):
+                return attacks
+            if line.startswith('# error'):
+                raise HammerError(line.split(':', 1)[1].strip())
+            if line.startswith('#') or not line.strip():
+                continue
+            attacks.append(fliptable.Attack.decode_line(line))
+        raise HammerError('connection closed')
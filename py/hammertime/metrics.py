@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+# -*- coding: UTF-8 -*-
+# Copyright (c) 2018 Vrije Universiteit Amsterdam
+#
+# This program is licensed under the GPL2+.
+
+"""Monitor for the live counters published by `tester --metrics`.
+
+usage: python3 -m hammertime.metrics [NAME ...] [-i SECS]
+
+Polls /dev/shm/NAME (default: every /dev/shm/trrespass.*) and prints the
+rates between two polls. Reading the page never touches the tester.
+"""
+
+import ctypes
+import glob
+import mmap
+import os
+import sys
+import time
+
+from hammertime.dramtrans import DRAMAddr
+
+MAGIC = 0x7472726d65747273
+SHM_DIR = '/dev/shm/'
+PREFIX = 'trrespass.'
+BANKS = 64
+PATT = 32
+
+
+class Page(ctypes.Structure):
+    _fields_ = [('magic', ctypes.c_uint64),
+                ('pid', ctypes.c_int64),
+                ('start', ctypes.c_uint64),
+                ('beat_ns', ctypes.c_uint64),
+                ('patterns', ctypes.c_uint64),
+                ('rounds', ctypes.c_uint64),
+                ('acts', ctypes.c_uint64),
+                ('hammer_ns', ctypes.c_uint64),
+                ('scan_bytes', ctypes.c_uint64),
+                ('scan_ns', ctypes.c_uint64),
+                ('flips', ctypes.c_uint64),
+                ('bank_flips', ctypes.c_uint64 * BANKS),
+                ('patt_seq', ctypes.c_uint64),
+                ('patt_len', ctypes.c_uint64),
+                ('patt', ctypes.c_uint64 * PATT)]
+
+
+class Metrics:
+    """Read-only mapping of the metrics page of one run"""
+
+    def __init__(self, name):
+        self.path = name if name.startswith('/dev/') else SHM_DIR + name.lstrip('/')
+        with open(self.path, 'rb') as f:
+            self.mm = mmap.mmap(f.fileno(), ctypes.sizeof(Page), prot=mmap.PROT_READ)
+        self.page = Page.from_buffer_copy(self.mm)
+        if self.page.magic != MAGIC:
+            raise ValueError('{}: not a metrics page'.format(self.path))
+
+    def snapshot(self):
+        """Copy of the counters, the pattern is retried until consistent"""
+        for _ in range(100):
+            page = Page.from_buffer_copy(self.mm)
+            if page.patt_seq % 2 == 0:
+                seq = Page.from_buffer_copy(self.mm).patt_seq
+                if seq == page.patt_seq:
+                    return page
+        return page
+
+    def alive(self):
+        try:
+            os.kill(self.page.pid, 0)
+        except ProcessLookupError:
+            return False
+        except PermissionError:
+            pass
+        return os.path.exists(self.path)
+
+    def close(self):
+        self.mm.close()
+
+
+def pattern(page):
+    n = min(page.patt_len, PATT)
+    return [DRAMAddr(w >> 32, w & 0xffffffff, 0) for w in page.patt[:n]]
+
+
+def rates(old, new, secs):
+    """Per second rates between two snapshots"""
+    d = lambda f: getattr(new, f) - getattr(old, f)
+    return {
+        'patt/s': d('patterns') / secs,
+        'rounds/s': d('rounds') / secs,
+        'ACT/s': d('acts') / secs,
+        # while hammering, without the scans and the pattern setup
+        'ACT/s hammer': d('acts') * 1e9 / d('hammer_ns') if d('hammer_ns') else 0.0,
+        'scan GB/s': d('scan_bytes') / d('scan_ns') if d('scan_ns') else 0.0,
+        'flips/s': d('flips') / secs,
+    }
+
+
+def fmt(page, r):
+    s = '[{}] up {:.0f}s patterns: {} flips: {}\n'.format(
+        page.pid, time.time() - page.start, page.patterns, page.flips)
+    s += '  ' + '  '.join('{}: {:.3g}'.format(k, v) for k, v in r.items()) + '\n'
+    banks = ['{}:{}'.format(b, n) for b, n in enumerate(page.bank_flips) if n]
+    if banks:
+        s += '  flips/bank: ' + ' '.join(banks) + '\n'
+    aggrs = pattern(page)
+    if aggrs:
+        s += '  current: ' + ' '.join('({},{})'.format(a.bank, a.row) for a in aggrs)
+        if page.patt_len > PATT:
+            s += ' +{}'.format(page.patt_len - PATT)
+        s += '\n'
+    return s
+
+
+def find():
+    return sorted(os.path.basename(p) for p in glob.glob(SHM_DIR + PREFIX + '*'))
+
+
+def monitor(names, interval):
+    runs = {}
+    while True:
+        for n in names or find():
+            if n not in runs:
+                try:
+                    m = Metrics(n)
+                except (OSError, ValueError) as e:
+                    print(e, file=sys.stderr)
+                    continue
+                runs[n] = (m, m.snapshot(), time.monotonic())
+        if not runs:
+            print('No metrics page in {}'.format(SHM_DIR), file=sys.stderr)
+            return
+        time.sleep(interval)
+        for n, (m, old, t0) in list(runs.items()):
+            if not m.alive():
+                print('[{}] gone'.format(m.page.pid))
+                m.close()
+                del runs[n]
+                continue
+            new, t1 = m.snapshot(), time.monotonic()
+            print(fmt(new, rates(old, new, t1 - t0)), end='')
+            runs[n] = (m, new, t1)
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    args = sys.argv[1:]
+    interval = 1.0
+    if '-i' in args:
+        i = args.index('-i')
+        interval = float(args[i + 1])
+        del args[i:i + 2]
+    try:
+        monitor(args, interval)
+    except KeyboardInterrupt:
+        pass
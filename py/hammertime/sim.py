@@ -135,3 +135,27 @@ class FliptableEstimator(BaseEstimator):
         est = cls(ftbl, msys, h_time)
         est.run_exploit(model)
         est.print_stats()
+
+
+class StreamEstimator(BaseEstimator):
+    """Estimator fed by the flips of a running tester (see `--flip-stream`)"""
+
+    def __init__(self, stream, memsys, atk_time):
+        self.stream = stream
+        self.msys = memsys
+        self.atk_time = atk_time # ms
+        super().__init__()
+
+    def iter_attacks(self):
+        for atk in self.stream.attacks():
+            yield _map_attack(atk, self.msys)
+
+    @classmethod
+    def main(cls, stream_name, msys_file, model, atk_time):
+        """Follow a flip stream until its run exits and print out statistics"""
+        from hammertime import flipstream
+        msys = dramtrans.MemorySystem()
+        msys.load_file(msys_file)
+        est = cls(flipstream.FlipStream(stream_name), msys, atk_time)
+        est.run_exploit(model)
+        est.print_stats()
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# -*- coding: UTF-8 -*-
+# Copyright (c) 2018 Vrije Universiteit Amsterdam
+#
+# This program is licensed under the GPL2+.
+
+"""Reader for the hammer window traces written by `tester --trace`."""
+
+import array
+import ctypes
+
+from hammertime.dramtrans import DRAMAddr
+
+MAGIC = 0x7472727472616365
+
+
+class Record(ctypes.Structure):
+    _fields_ = [('magic', ctypes.c_uint64),
+                ('seq', ctypes.c_uint64),
+                ('k', ctypes.c_uint64),
+                ('rounds', ctypes.c_uint64),
+                ('len', ctypes.c_uint64),
+                ('samples', ctypes.c_uint64),
+                ('dropped', ctypes.c_uint64),
+                ('cycles', ctypes.c_uint64),
+                ('ns', ctypes.c_uint64)]
+
+
+class Window:
+    """One hammer window: its aggressors and the tsc delta of every K rounds"""
+
+    def __init__(self, rec, aggrs, deltas):
+        self.rec = rec
+        self.aggrs = aggrs
+        self.deltas = deltas
+
+    @property
+    def ns_per_cycle(self):
+        return self.rec.ns / self.rec.cycles if self.rec.cycles else 0.0
+
+    def sample_ns(self):
+        """Duration of every sample in ns"""
+        f = self.ns_per_cycle
+        return [d * f for d in self.deltas]
+
+    def stalls(self, factor=4):
+        """(index, ns) of the samples slower than `factor` times the median"""
+        if not self.deltas:
+            return []
+        med = sorted(self.deltas)[len(self.deltas) // 2]
+        f = self.ns_per_cycle
+        return [(i, d * f) for i, d in enumerate(self.deltas) if d > factor * med]
+
+    def __str__(self):
+        return 'window {0.seq}: {1} aggr, {0.rounds} rounds, {0.samples} samples/{0.k}'.format(
+            self.rec, len(self.aggrs))
+
+
+def read_trace(path):
+    """Yields every Window of a trace file"""
+    size = ctypes.sizeof(Record)
+    with open(path, 'rb') as f:
+        while True:
+            buf = f.read(size)
+            if len(buf) < size:
+                return
+            rec = Record.from_buffer_copy(buf)
+            if rec.magic != MAGIC:
+                raise ValueError('{}: bad record at offset {}'.format(path, f.tell() - size))
+            words = array.array('Q')
+            words.frombytes(f.read(8 * rec.len))
+            aggrs = [DRAMAddr(w >> 32, w & 0xffffffff, 0) for w in words]
+            deltas = array.array('I')
+            deltas.frombytes(f.read(4 * rec.samples))
+            yield Window(rec, aggrs, deltas)